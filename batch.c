@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "error.h"
+#include "commands.h"
+#include "interactive.h"
+
+#include "batch.h"
+
+// Results of all queries are written through a single buffer of that size
+#define BATCH_OUTPUT_BUFFER_LEN (1LU << 20)
+
+FILE* open_batch_input(char* batch_path);
+FILE* open_batch_output(char* buffer);
+void execute_batch_line(
+    char* line,
+    size_t line_number,
+    command_t* commands,
+    size_t command_count,
+    indexing_data_t* data
+);
+
+void run_batch(indexing_data_t* data, char* batch_path, output_format_t format) {
+    FILE* input = open_batch_input(batch_path);
+    char* output_buffer = malloc(BATCH_OUTPUT_BUFFER_LEN);
+    if(output_buffer == NULL) ERR("malloc");
+    data->output.stream = open_batch_output(output_buffer);
+    data->output.format = format;
+    data->output.query_number = 0;
+
+    command_t* commands = NULL;
+    size_t command_count = get_available_commands(&commands);
+    char* line = NULL;
+    size_t line_buf_len = 0;
+    size_t line_number = 0;
+
+    // All queries are answered from the same index
+    pthread_mutex_lock(&data->mx_index);
+    while(getline(&line, &line_buf_len, input) != -1)
+        execute_batch_line(line, ++line_number, commands, command_count, data);
+    if(ferror(input)) ERR("getline");
+    pthread_mutex_unlock(&data->mx_index);
+
+    if(fclose(data->output.stream)) ERR("fclose");
+    init_interactive_output(&data->output);
+    free(output_buffer);
+    free(line);
+    if(input != stdin && fclose(input)) ERR("fclose");
+}
+
+FILE* open_batch_input(char* batch_path) {
+    if(strcmp(batch_path, "-") == 0) return stdin;
+    FILE* input = fopen(batch_path, "r");
+    if(input == NULL) ERR("fopen");
+    return input;
+}
+
+// Separate stream, so that the buffer of stdout is not replaced after it has been used
+FILE* open_batch_output(char* buffer) {
+    int file_desc = dup(STDOUT_FILENO);
+    if(file_desc < 0) ERR("dup");
+    FILE* output = fdopen(file_desc, "w");
+    if(output == NULL) ERR("fdopen");
+    if(setvbuf(output, buffer, _IOFBF, BATCH_OUTPUT_BUFFER_LEN)) ERR("setvbuf");
+    return output;
+}
+
+void execute_batch_line(
+    char* line,
+    size_t line_number,
+    command_t* commands,
+    size_t command_count,
+    indexing_data_t* data
+) {
+    size_t line_len = strlen(line);
+    if(line_len > 0 && line[line_len - 1] == '\n') line[--line_len] = '\0';
+    if(line_len == 0) return;
+
+    // Commands have to end with two NUL characters
+    char* command_str = malloc(line_len + 2);
+    if(command_str == NULL) ERR("malloc");
+    memcpy(command_str, line, line_len);
+    command_str[line_len] = '\0';
+    command_str[line_len + 1] = '\0';
+
+    command_t* command = get_matching_command(command_str, commands, command_count);
+    if(command == NULL || !command->allowed_in_batch)
+        fprintf(stderr, "Line %lu: command not available in batch mode\n", line_number);
+    else {
+        data->output.query_number += 1;
+        print_query_start(&data->output, command_str);
+        execute_command(command_str, commands, command_count, data);
+        print_query_end(&data->output);
+    }
+
+    free(command_str);
+}
@@ -0,0 +1,11 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "index.h"
+#include "output.h"
+
+// Executes queries read line by line from `batch_path` ("-" means stdin) against
+// a single index snapshot, without prompts, writing results in `format` to stdout
+void run_batch(indexing_data_t* data, char* batch_path, output_format_t format);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef CASE_FOLD_H
+#define CASE_FOLD_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+// Folding turns at most 2 bytes into 3 (U+023A and U+023E), so `len` bytes of UTF-8
+// take at most MAX_FOLDED_LEN(len) bytes once folded
+#define MAX_FOLDED_LEN(len) ((len) / 2 * 3 + (len) % 2)
+
+// Writes at most `max_len` bytes of the case folded `name` and a terminating NUL to `folded`.
+// Characters are folded by Unicode simple case folding, invalid UTF-8 is copied.
+// Characters which would not fit are dropped whole, which never happens
+// if `max_len` is at least MAX_FOLDED_LEN(strlen(name)).
+void fold_case(char* name, char* folded, size_t max_len);
+// Returns the length of the UTF-8 encoded character at `str` and stores it in `code_point`,
+// 0 if the character is invalid or is not encoded in the shortest form
+size_t decode_utf8(unsigned char* str, uint32_t* code_point);
+
+#endif
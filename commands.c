@@ -1,50 +1,90 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <limits.h>
 #include <pthread.h>
 
 #include "error.h"
 
 #include "commands.h"
 #include "file_io.h"
-
-typedef bool (*filter_t) (file_t* file, void* data);
+#include "duplicates.h"
+#include "query_executor.h"
+#include "query.h"
+#include "rollup.h"
+#include "subtree.h"
 
 command_result_t* cmd_exit(char* args, indexing_data_t* data);
 void stop_indexing(indexing_data_t* data);
 command_result_t* cmd_exit_exclam(char* args, indexing_data_t* data);
 command_result_t* cmd_index(char* args, indexing_data_t* data);
 command_result_t* cmd_count(char* args, indexing_data_t* data);
-size_t* count_filetypes(indexing_data_t* data);
 command_result_t* cmd_largerthan(char* args, indexing_data_t* data);
-bool largerthan_filter(file_t* file, void* min_size);
 command_result_t* cmd_namepart(char* args, indexing_data_t* data);
-bool namepart_filter(file_t* file, void* namepart);
 command_result_t* cmd_owner(char* args, indexing_data_t* data);
-bool owner_filter(file_t* file, void* uid);
-bool ensure_args_absent(char* args, char* cmd_name);
-bool ensure_args_present(char* args, char* cmd_name);
-void filter_and_print_files(indexing_data_t* data, filter_t filter, void* filter_data);
-size_t filter_files(
-    index_t* index,
-    filter_t filter,
-    void* filter_data,
-    bool* should_be_displayed
+command_result_t* cmd_nameglob(char* args, indexing_data_t* data);
+command_result_t* cmd_nameregex(char* args, indexing_data_t* data);
+command_result_t* cmd_inamepart(char* args, indexing_data_t* data);
+command_result_t* cmd_inameglob(char* args, indexing_data_t* data);
+command_result_t* cmd_inameregex(char* args, indexing_data_t* data);
+command_result_t* cmd_newerthan(char* args, indexing_data_t* data);
+command_result_t* cmd_olderthan(char* args, indexing_data_t* data);
+void run_named_query(indexing_data_t* data, char* name, char* args);
+command_result_t* cmd_largest(char* args, indexing_data_t* data);
+command_result_t* cmd_smallest(char* args, indexing_data_t* data);
+void run_top_query(indexing_data_t* data, char* args, char* cmd_name, heap_compare_t compare);
+command_result_t* cmd_sort(char* args, indexing_data_t* data);
+bool try_to_parse_sort_key(char** args, heap_compare_t* compare);
+void run_ordered_query(
+    indexing_data_t* data,
+    char* query_str,
+    char* scope_path,
+    ordering_t* ordering
 );
-FILE* open_fileprinting_stream(size_t items);
-void close_filepriting_stream(FILE* stream);
-void print_files(indexing_data_t* data, bool* should_be_displayed, FILE* stream);
-void print_file(file_t* file, filetype_t* filetypes, FILE* stream);
+command_result_t* cmd_duplicates(char* args, indexing_data_t* data);
+void print_duplicate_groups(indexing_data_t* data, duplicate_groups_t* groups);
+void save_index_if_not_indexing(indexing_data_t* data);
+command_result_t* cmd_throttle(char* args, indexing_data_t* data);
+void print_throttle_limits(throttle_t* throttle);
+command_result_t* cmd_cache(char* args, indexing_data_t* data);
+command_result_t* cmd_du(char* args, indexing_data_t* data);
+bool try_to_split_depth(char* args, size_t* depth);
+void print_directory_usage(indexing_data_t* data, char* path, size_t depth);
+void print_rollup(indexing_data_t* data, FILE* stream, char* path, directory_rollup_t* rollup);
+size_t get_relative_depth(char* path, size_t dir_path_len);
+command_result_t* cmd_schedule(char* args, indexing_data_t* data);
+bool try_to_nudge_schedule(rebuild_scheduler_t* scheduler, char* args);
+void print_schedule(rebuild_scheduler_t* scheduler);
+command_result_t* cmd_changes(char* args, indexing_data_t* data);
+void print_index_diff(indexing_data_t* data, index_diff_t* diff);
+void print_file_change(indexing_data_t* data, index_diff_t* diff, file_change_t* change);
+char* get_filetype_name(indexing_data_t* data, size_t type);
 
 size_t get_available_commands(command_t** commands) {
     static command_t st_commands[] = {
-        { "exit", cmd_exit },
-        { "exit!", cmd_exit_exclam },
-        { "index", cmd_index },
-        { "count", cmd_count },
-        { "largerthan", cmd_largerthan },
-        { "namepart", cmd_namepart },
-        { "owner", cmd_owner }
+        { "exit", cmd_exit, false, true },
+        { "exit!", cmd_exit_exclam, false, true },
+        { "index", cmd_index, false, false },
+        { "count", cmd_count, true, true },
+        { "largerthan", cmd_largerthan, true, true },
+        { "namepart", cmd_namepart, true, true },
+        { "owner", cmd_owner, true, true },
+        { "nameglob", cmd_nameglob, true, true },
+        { "nameregex", cmd_nameregex, true, true },
+        { "inamepart", cmd_inamepart, true, true },
+        { "inameglob", cmd_inameglob, true, true },
+        { "inameregex", cmd_inameregex, true, true },
+        { "newerthan", cmd_newerthan, true, true },
+        { "olderthan", cmd_olderthan, true, true },
+        { "largest", cmd_largest, true, true },
+        { "smallest", cmd_smallest, true, true },
+        { "sort", cmd_sort, true, true },
+        { "duplicates", cmd_duplicates, false, false },
+        { "throttle", cmd_throttle, false, false },
+        { "cache", cmd_cache, false, true },
+        { "du", cmd_du, true, true },
+        { "schedule", cmd_schedule, false, false },
+        { "changes", cmd_changes, false, false }
     };
 
     *commands = st_commands;
@@ -89,58 +129,242 @@ command_result_t* cmd_index(char* args, indexing_data_t* data) {
     return NULL;
 }
 
+// `count [under path]`
 command_result_t* cmd_count(char* args, indexing_data_t* data) {
+    char* scope_path = split_scope_path(&args);
     if(!ensure_args_absent(args, "count")) return NULL;
-    size_t* counts = count_filetypes(data);
+    file_range_t range;
+    if(!try_to_resolve_scope(data, scope_path, &range)) return NULL;
+    size_t* counts =
+        count_filetypes(&data->query_pool, &data->index, &range, data->filetypes_count);
 
-    printf("File type \t\t\t File count\n");
+    FILE* stream = data->output.stream != NULL ? data->output.stream : stdout;
+    if(data->output.format == OUTPUT_TEXT) fprintf(stream, "File type \t\t\t File count\n");
     for(size_t i = 0; i < data->filetypes_count; ++i)
-        printf("%s \t\t\t %lu\n", data->filetypes[i].name, counts[i]);
+        print_filetype_count(&data->output, stream, data->filetypes[i].name, counts[i]);
 
     free(counts);
     return NULL;
 }
 
-size_t* count_filetypes(indexing_data_t* data) {
-    size_t* counts = calloc(data->filetypes_count, sizeof(size_t));
-    if(counts == NULL) ERR("calloc");
+command_result_t* cmd_largerthan(char* args, indexing_data_t* data) {
+    run_named_query(data, "largerthan", args);
+    return NULL;
+}
 
-    for(size_t i = 0; i < data->index.files_count; ++i)
-        counts[data->index.files[i].type] += 1;
+command_result_t* cmd_namepart(char* args, indexing_data_t* data) {
+    run_named_query(data, "namepart", args);
+    return NULL;
+}
 
-    return counts;
+command_result_t* cmd_owner(char* args, indexing_data_t* data) {
+    run_named_query(data, "owner", args);
+    return NULL;
 }
 
-command_result_t* cmd_largerthan(char* args, indexing_data_t* data) {
-    if(!ensure_args_present(args, "largerthan")) return NULL;
-    off_t min_size = atoi(args);
-    filter_and_print_files(data, largerthan_filter, &min_size);
+command_result_t* cmd_nameglob(char* args, indexing_data_t* data) {
+    run_named_query(data, "nameglob", args);
     return NULL;
 }
 
-bool largerthan_filter(file_t* file, void* min_size) {
-    return file->size > *(off_t*)min_size;
+command_result_t* cmd_nameregex(char* args, indexing_data_t* data) {
+    run_named_query(data, "nameregex", args);
+    return NULL;
 }
 
-command_result_t* cmd_namepart(char* args, indexing_data_t* data) {
-    if(!ensure_args_present(args, "namepart")) return NULL;
-    filter_and_print_files(data, namepart_filter, args);
+command_result_t* cmd_inamepart(char* args, indexing_data_t* data) {
+    run_named_query(data, "inamepart", args);
+    return NULL;
+}
+
+command_result_t* cmd_inameglob(char* args, indexing_data_t* data) {
+    run_named_query(data, "inameglob", args);
     return NULL;
 }
 
-bool namepart_filter(file_t* file, void* namepart) {
-    return strstr(file->name, namepart) != NULL;
+command_result_t* cmd_inameregex(char* args, indexing_data_t* data) {
+    run_named_query(data, "inameregex", args);
+    return NULL;
 }
 
-command_result_t* cmd_owner(char* args, indexing_data_t* data) {
-    if(!ensure_args_present(args, "owner")) return NULL;
-    uid_t uid = atoi(args);
-    filter_and_print_files(data, owner_filter, &uid);
+command_result_t* cmd_newerthan(char* args, indexing_data_t* data) {
+    run_named_query(data, "newerthan", args);
+    return NULL;
+}
+
+command_result_t* cmd_olderthan(char* args, indexing_data_t* data) {
+    run_named_query(data, "olderthan", args);
+    return NULL;
+}
+
+// Every query can be followed by `under path`, which restricts it to the contents of a directory
+void run_named_query(indexing_data_t* data, char* name, char* args) {
+    char* scope_path = split_scope_path(&args);
+    query_t query;
+    if(!try_to_parse_named_query(name, args, &query)) return;
+    if(try_to_restrict_query(data, &query, scope_path)) execute_query(data, &query, NULL);
+    destroy_query(&query);
+}
+
+// `largest k [query]` prints k largest files matching the query
+command_result_t* cmd_largest(char* args, indexing_data_t* data) {
+    run_top_query(data, args, "largest", compare_by_size_descending);
+    return NULL;
+}
+
+// `smallest k [query]` prints k smallest files matching the query
+command_result_t* cmd_smallest(char* args, indexing_data_t* data) {
+    run_top_query(data, args, "smallest", compare_by_size_ascending);
+    return NULL;
+}
+
+void run_top_query(indexing_data_t* data, char* args, char* cmd_name, heap_compare_t compare) {
+    char* scope_path = split_scope_path(&args);
+    if(!ensure_args_present(args, cmd_name)) return;
+    char* query_str;
+    long long limit = strtoll(args, &query_str, 10);
+    if(query_str == args || limit <= 0 || (*query_str != '\0' && *query_str != ' ')) {
+        fprintf(stderr, "Usage: %s k [query]\n", cmd_name);
+        return;
+    }
+
+    ordering_t ordering = { .compare = compare, .limit = limit };
+    run_ordered_query(data, *query_str == '\0' ? NULL : query_str + 1, scope_path, &ordering);
+}
+
+// `sort by size|name|path [query]` prints all files matching the query in the given order
+command_result_t* cmd_sort(char* args, indexing_data_t* data) {
+    ordering_t ordering = { .limit = 0 };
+    char* scope_path = split_scope_path(&args);
+    if(args == NULL || !try_to_parse_sort_key(&args, &ordering.compare)) {
+        fprintf(stderr, "Usage: sort by size|name|path [query]\n");
+        return NULL;
+    }
+
+    run_ordered_query(data, args, scope_path, &ordering);
+    return NULL;
+}
+
+// Moves `args` past the sort key, to the query (NULL if there is none)
+bool try_to_parse_sort_key(char** args, heap_compare_t* compare) {
+    static struct { char* name; heap_compare_t compare; } st_sort_keys[] = {
+        { "by size", compare_by_size_descending },
+        { "by name", compare_by_name },
+        { "by path", compare_by_path }
+    };
+
+    for(size_t i = 0; i < sizeof(st_sort_keys) / sizeof(st_sort_keys[0]); ++i) {
+        size_t key_len = strlen(st_sort_keys[i].name);
+        if(strncmp(*args, st_sort_keys[i].name, key_len) != 0) continue;
+        if((*args)[key_len] != '\0' && (*args)[key_len] != ' ') continue;
+        *compare = st_sort_keys[i].compare;
+        *args = (*args)[key_len] == '\0' ? NULL : *args + key_len + 1;
+        return true;
+    }
+
+    return false;
+}
+
+void run_ordered_query(
+    indexing_data_t* data,
+    char* query_str,
+    char* scope_path,
+    ordering_t* ordering
+) {
+    query_t query;
+    if(!try_to_parse_query(query_str, &query)) return;
+    if(try_to_restrict_query(data, &query, scope_path)) execute_query(data, &query, ordering);
+    destroy_query(&query);
+}
+
+command_result_t* cmd_duplicates(char* args, indexing_data_t* data) {
+    if(!ensure_args_absent(args, "duplicates")) return NULL;
+
+    // Files are hashed without holding the index, so that rebuilds and snapshots can be published
+    pthread_mutex_lock(&data->mx_index);
+    duplicate_candidates_t candidates = collect_duplicate_candidates(&data->index);
+    uint64_t generation = data->index.generation;
+    pthread_mutex_unlock(&data->mx_index);
+
+    duplicate_groups_t groups = find_duplicates(&candidates, &data->query_pool);
+
+    // Records of a replaced index could have changed, its hashes are not updated
+    pthread_mutex_lock(&data->mx_index);
+    bool is_index_current = data->index.generation == generation;
+    if(is_index_current && groups.prefix_hashes_computed + groups.full_hashes_computed > 0) {
+        store_content_hashes(&candidates, &data->index);
+        save_index_if_not_indexing(data);
+    }
+    pthread_mutex_unlock(&data->mx_index);
+
+    print_duplicate_groups(data, &groups);
+
+    printf(
+        "%lu groups of duplicates found "
+        "(%lu prefix hashes and %lu full hashes computed, %lu cached hashes reused, "
+        "%lu files changed since indexing)\n",
+        groups.group_count,
+        groups.prefix_hashes_computed,
+        groups.full_hashes_computed,
+        groups.cached_hashes_used,
+        groups.stale_files
+    );
+    destroy_duplicate_groups(&groups);
+    destroy_duplicate_candidates(&candidates);
     return NULL;
 }
 
-bool owner_filter(file_t* file, void* uid) {
-    return file->owner == *(uid_t*)uid;
+void print_duplicate_groups(indexing_data_t* data, duplicate_groups_t* groups) {
+    FILE* stream = open_fileprinting_stream(data, groups->group_starts[groups->group_count]);
+    for(size_t i = 0; i < groups->group_count; ++i) {
+        fprintf(stream, "Duplicate group %lu:\n", i + 1);
+        for(size_t j = groups->group_starts[i]; j < groups->group_starts[i + 1]; ++j)
+            print_file(data, groups->files[j], stream);
+    }
+    close_filepriting_stream(data, stream);
+}
+
+// Newly computed hashes are persisted, unless a new index is being built.
+// In that case they are carried over to the new index and saved with it.
+void save_index_if_not_indexing(indexing_data_t* data) {
+    if(pthread_mutex_trylock(&data->mx_indexing_process)) return;
+    save_index_to_file(data->index_path, &data->index);
+    pthread_mutex_unlock(&data->mx_indexing_process);
+}
+
+// `throttle` prints current limits, `throttle off` disables throttling
+// and `throttle ops bytes` sets new limits, where 0 means no limit
+command_result_t* cmd_throttle(char* args, indexing_data_t* data) {
+    if(args != NULL) {
+        double ops_per_second, bytes_per_second;
+        if(strcmp(args, "off") == 0)
+            throttle_set_limits(&data->throttle, THROTTLE_UNLIMITED, THROTTLE_UNLIMITED);
+        else if(sscanf(args, "%lf %lf", &ops_per_second, &bytes_per_second) == 2 &&
+            ops_per_second >= 0.0 && bytes_per_second >= 0.0)
+            throttle_set_limits(&data->throttle, ops_per_second, bytes_per_second);
+        else {
+            fprintf(stderr, "Usage: throttle [off | operations/s bytes/s]\n");
+            return NULL;
+        }
+    }
+
+    print_throttle_limits(&data->throttle);
+    return NULL;
+}
+
+void print_throttle_limits(throttle_t* throttle) {
+    double ops_per_second, bytes_per_second;
+    throttle_get_limits(throttle, &ops_per_second, &bytes_per_second);
+    if(!throttle_is_enabled(throttle)) {
+        printf("Indexing is not throttled\n");
+        return;
+    }
+
+    printf("Indexing is throttled to ");
+    if(ops_per_second == THROTTLE_UNLIMITED) printf("unlimited operations/s");
+    else printf("%.1lf operations/s", ops_per_second);
+    if(bytes_per_second == THROTTLE_UNLIMITED) printf(" and unlimited bytes/s\n");
+    else printf(" and %.1lf bytes/s\n", bytes_per_second);
 }
 
 bool ensure_args_present(char* args, char* cmd_name) {
@@ -161,50 +385,223 @@ bool ensure_args_absent(char* args, char* cmd_name) {
     return true;
 }
 
-void filter_and_print_files(indexing_data_t* data, filter_t filter, void* filter_data) {
-    bool* should_be_displayed = malloc(data->index.files_count * sizeof(bool));
-    size_t items = filter_files(&data->index, filter, filter_data, should_be_displayed);
+command_result_t* cmd_cache(char* args, indexing_data_t* data) {
+    query_cache_t* cache = &data->query_cache;
+    if(args != NULL) {
+        if(strcmp(args, "clear") != 0) {
+            fprintf(stderr, "Usage: cache [clear]\n");
+            return NULL;
+        }
+        query_cache_clear(cache);
+    }
 
-    FILE* stream = open_fileprinting_stream(items);
-    print_files(data, should_be_displayed, stream);
-    close_filepriting_stream(stream);
-    free(should_be_displayed);
+    size_t lookups = cache->hits + cache->misses;
+    printf("Cached queries: %lu/%lu\n", cache->entries_count, QUERY_CACHE_CAPACITY);
+    printf("Memory used: %lu/%lu bytes\n", cache->memory_used, QUERY_CACHE_MAX_MEMORY);
+    printf(
+        "Hits: %lu, misses: %lu, hit rate: %.1lf%%\n",
+        cache->hits,
+        cache->misses,
+        lookups == 0 ? 0.0 : 100.0 * cache->hits / lookups
+    );
+    printf("Evictions: %lu, invalidations: %lu\n", cache->evictions, cache->invalidations);
+    return NULL;
 }
 
-size_t filter_files(
-    index_t* index,
-    filter_t filter,
-    void* filter_data,
-    bool* should_be_displayed
-) {
-    size_t items = 0;
-    for(size_t i = 0; i < index->files_count; ++i) {
-        should_be_displayed[i] = filter(&index->files[i], filter_data);
-        items += should_be_displayed[i];
+// `du path [depth]` prints totals of the directory and of its subdirectories
+// at most `depth` levels below it
+command_result_t* cmd_du(char* args, indexing_data_t* data) {
+    if(!ensure_args_present(args, "du")) return NULL;
+    size_t depth = 0;
+    if(!try_to_split_depth(args, &depth)) {
+        fprintf(stderr, "Usage: du path [depth]\n");
+        return NULL;
+    }
+
+    char* path = resolve_indexed_path(args);
+    print_directory_usage(data, path, depth);
+    free(path);
+    return NULL;
+}
+
+// Paths can contain spaces, so only a number at the end is treated as the depth
+bool try_to_split_depth(char* args, size_t* depth) {
+    char* depth_str = strrchr(args, ' ');
+    if(depth_str == NULL) return true;
+    char* end;
+    long long value = strtoll(depth_str + 1, &end, 10);
+    if(end == depth_str + 1 || *end != '\0') return true;
+    if(value < 0) return false;
+    *depth = value;
+    *depth_str = '\0';
+    return true;
+}
+
+void print_directory_usage(indexing_data_t* data, char* path, size_t depth) {
+    file_range_t range;
+    file_t* dir;
+    if(!try_to_find_subtree(data, path, &range, &dir)) {
+        fprintf(stderr, "Directory %s is not indexed!\n", path);
+        return;
     }
 
-    return items;
+    directory_rollup_t* rollup = dir != NULL ? &dir->rollup : &data->index.root_rollup;
+    FILE* stream = data->output.stream != NULL ? data->output.stream : stdout;
+    print_rollup(data, stream, path, rollup);
+    if(depth == 0) return;
+
+    size_t path_len = strlen(path);
+    for(size_t i = range.first; i < range.last; ++i) {
+        file_t* file = &data->index.files[i];
+        if(file->type == FILETYPE_DIRECTORY && get_relative_depth(file->path, path_len) <= depth)
+            print_rollup(data, stream, file->path, &file->rollup);
+    }
+}
+
+void print_rollup(indexing_data_t* data, FILE* stream, char* path, directory_rollup_t* rollup) {
+    char* type_names[MAX_FILETYPES];
+    for(size_t i = 0; i < data->filetypes_count; ++i) type_names[i] = data->filetypes[i].name;
+    print_directory_rollup(
+        &data->output,
+        stream,
+        path,
+        rollup->total_size,
+        type_names,
+        rollup->type_counts,
+        data->filetypes_count
+    );
+}
+
+size_t get_relative_depth(char* path, size_t dir_path_len) {
+    size_t depth = 0;
+    for(char* c = path + dir_path_len; *c != '\0'; ++c)
+        if(*c == '/') depth += 1;
+    return depth;
+}
+
+// `schedule` prints when the index is rebuilt next and why,
+// `schedule now|sooner|later|seconds` overrides the adapted interval
+command_result_t* cmd_schedule(char* args, indexing_data_t* data) {
+    rebuild_scheduler_t* scheduler = &data->rebuild_scheduler;
+    if(args != NULL && !try_to_nudge_schedule(scheduler, args)) {
+        fprintf(stderr, "Usage: schedule [now | sooner | later | seconds]\n");
+        return NULL;
+    }
+
+    print_schedule(scheduler);
+    return NULL;
+}
+
+bool try_to_nudge_schedule(rebuild_scheduler_t* scheduler, char* args) {
+    int interval;
+    time_t next_rebuild_time;
+    char reason[MAX_REBUILD_REASON_LEN];
+    rebuild_scheduler_get_schedule(scheduler, &interval, &next_rebuild_time, reason);
+
+    char* end;
+    long seconds = strtol(args, &end, 10);
+    if(strcmp(args, "now") == 0) rebuild_scheduler_rebuild_now(scheduler);
+    else if(strcmp(args, "sooner") == 0)
+        rebuild_scheduler_set_interval(scheduler, interval / 2, "interval halved by command");
+    else if(strcmp(args, "later") == 0)
+        rebuild_scheduler_set_interval(scheduler, interval * 2, "interval doubled by command");
+    else if(end != args && *end == '\0' && seconds > 0 && seconds <= INT_MAX)
+        rebuild_scheduler_set_interval(scheduler, seconds, "interval set by command");
+    else return false;
+
+    return true;
 }
 
-FILE* open_fileprinting_stream(size_t items) {
-    FILE* stream = stdout;
-    if(items > 3 && getenv("PAGER") != NULL)
-        stream = popen(getenv("PAGER"), "w");
-    return stream;
+void print_schedule(rebuild_scheduler_t* scheduler) {
+    int interval;
+    time_t next_rebuild_time;
+    char reason[MAX_REBUILD_REASON_LEN];
+    rebuild_scheduler_get_schedule(scheduler, &interval, &next_rebuild_time, reason);
+    if(interval == 0) {
+        printf("Periodic indexing is disabled\n");
+        return;
+    }
+
+    time_t current_time = time(NULL);
+    if(current_time == -1) ERR("time");
+    printf("Rebuild interval: %d s\n", interval);
+    if(next_rebuild_time <= current_time) printf("Next rebuild: due now\n");
+    else printf("Next rebuild: in %ld s\n", (long)(next_rebuild_time - current_time));
+    printf("Reason: %s\n", reason);
 }
 
-void close_filepriting_stream(FILE* stream) {
-    if(stream != stdout)
-        pclose(stream);
+// `changes [n]` prints the changes made by the last `n` rebuilds (1 by default), latest first
+command_result_t* cmd_changes(char* args, indexing_data_t* data) {
+    size_t count = 1;
+    if(args != NULL) {
+        char* end;
+        long long value = strtoll(args, &end, 10);
+        if(end == args || *end != '\0' || value <= 0) {
+            fprintf(stderr, "Usage: changes [n]\n");
+            return NULL;
+        }
+        count = value;
+    }
+
+    pthread_mutex_lock(&data->mx_index);
+    index_history_t* history = &data->index_history;
+    if(history->diffs_count == 0) printf("No rebuilds have been completed yet\n");
+    for(size_t i = 0; i < count && i < history->diffs_count; ++i)
+        print_index_diff(data, index_history_get(history, i));
+    pthread_mutex_unlock(&data->mx_index);
+    return NULL;
+}
+
+void print_index_diff(indexing_data_t* data, index_diff_t* diff) {
+    char time_str[32];
+    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", localtime(&diff->creation_time));
+    printf(
+        "Generation %lu (indexed %s): %lu files changed, "
+        "%lu added, %lu removed, %lu resized, %lu retyped, %lu re-owned, %lu modified\n",
+        diff->generation,
+        time_str,
+        diff->changed_count,
+        diff->kind_counts[0],
+        diff->kind_counts[1],
+        diff->kind_counts[2],
+        diff->kind_counts[3],
+        diff->kind_counts[4],
+        diff->kind_counts[5]
+    );
+
+    for(size_t i = 0; i < diff->changes_count; ++i)
+        print_file_change(data, diff, &diff->changes[i]);
+    if(diff->changed_count > diff->changes_count)
+        printf("... and %lu more\n", diff->changed_count - diff->changes_count);
 }
 
-void print_files(indexing_data_t* data, bool* should_be_displayed, FILE* stream) {
-    for(size_t i = 0; i < data->index.files_count; ++i)
-        if(should_be_displayed[i]) print_file(&data->index.files[i], data->filetypes, stream); 
+void print_file_change(indexing_data_t* data, index_diff_t* diff, file_change_t* change) {
+    char* path = get_changed_file_path(diff, change);
+    if(change->kinds & CHANGE_ADDED) {
+        printf("+ %s (%s, %ld bytes)\n",
+            path, get_filetype_name(data, change->new_type), change->new_size);
+        return;
+    }
+    if(change->kinds & CHANGE_REMOVED) {
+        printf("- %s\n", path);
+        return;
+    }
+
+    printf("~ %s", path);
+    if(change->kinds & CHANGE_RESIZED)
+        printf(", size %ld -> %ld", change->old_size, change->new_size);
+    if(change->kinds & CHANGE_RETYPED)
+        printf(
+            ", type %s -> %s",
+            get_filetype_name(data, change->old_type),
+            get_filetype_name(data, change->new_type)
+        );
+    if(change->kinds & CHANGE_REOWNED)
+        printf(", owner %u -> %u", change->old_owner, change->new_owner);
+    if(change->kinds & CHANGE_MODIFIED) printf(", modified");
+    printf("\n");
 }
 
-void print_file(file_t* file, filetype_t* filetypes, FILE* stream) {
-    fprintf(stream, "Path: %s\n", file->path);
-    fprintf(stream, "Size: %lu\n", file->size);
-    fprintf(stream, "Type: %s\n", filetypes[file->type].name);
+char* get_filetype_name(indexing_data_t* data, size_t type) {
+    return type < data->filetypes_count ? data->filetypes[type].name : "unknown";
 }
@@ -12,8 +12,14 @@ typedef struct command_return {
 typedef struct command {
     char* name;
     command_result_t* (*handler) (char* args, indexing_data_t* data);
+    // Batch mode runs only read-only commands which print their results
+    bool allowed_in_batch;
+    // Clients of a shared index only run commands which neither modify nor rebuild it
+    bool allowed_in_client;
 } command_t;
 
 size_t get_available_commands(command_t** commands);
+bool ensure_args_absent(char* args, char* cmd_name);
+bool ensure_args_present(char* args, char* cmd_name);
 
 #endif
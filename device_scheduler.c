@@ -0,0 +1,177 @@
+#include <string.h>
+#include <sys/vfs.h>
+
+#include "error.h"
+
+#include "device_scheduler.h"
+
+#define STARTING_QUEUE_CAPACITY 16LU
+
+#define NFS_SUPER_MAGIC 0x6969
+#define SMB_SUPER_MAGIC 0x517b
+#define CIFS_SUPER_MAGIC 0xff534d42
+#define SMB2_SUPER_MAGIC 0xfe534d42
+#define CEPH_SUPER_MAGIC 0x00c36400
+#define AFS_SUPER_MAGIC 0x5346414f
+#define FUSE_SUPER_MAGIC 0x65735546
+
+device_queue_t* get_device_queue(device_scheduler_t* scheduler, dev_t device, char* dir_path);
+device_queue_t* add_device_queue(device_scheduler_t* scheduler, dev_t device, char* dir_path);
+bool is_network_filesystem(char* dir_path);
+device_queue_t* find_device_queue(device_scheduler_t* scheduler, dev_t device);
+device_queue_t* find_ready_device_queue(device_scheduler_t* scheduler);
+
+void device_scheduler_init(device_scheduler_t* scheduler, size_t thread_count) {
+    if(pthread_mutex_init(&scheduler->mx_scheduler, NULL)) ERR("pthread_mutex_init");
+    if(pthread_cond_init(&scheduler->cv_work_available, NULL)) ERR("pthread_cond_init");
+    scheduler->devices = NULL;
+    scheduler->device_count = 0;
+    scheduler->next_device = 0;
+    scheduler->active_count = 0;
+    scheduler->thread_count = thread_count;
+    scheduler->done_count = 0;
+    scheduler->is_stopped = false;
+}
+
+void device_scheduler_push(device_scheduler_t* scheduler, dev_t device, char* dir_path) {
+    pthread_mutex_lock(&scheduler->mx_scheduler);
+    device_queue_t* queue = get_device_queue(scheduler, device, dir_path);
+    if(queue->dir_count == queue->capacity) {
+        queue->capacity *= 2;
+        queue->dir_paths = realloc(queue->dir_paths, queue->capacity * sizeof(char*));
+        if(queue->dir_paths == NULL) ERR("realloc");
+    }
+
+    queue->dir_paths[queue->dir_count++] = dir_path;
+    pthread_cond_signal(&scheduler->cv_work_available);
+    pthread_mutex_unlock(&scheduler->mx_scheduler);
+}
+
+device_queue_t* get_device_queue(device_scheduler_t* scheduler, dev_t device, char* dir_path) {
+    device_queue_t* queue = find_device_queue(scheduler, device);
+    return queue != NULL ? queue : add_device_queue(scheduler, device, dir_path);
+}
+
+// The first directory of a device decides its concurrency limit
+device_queue_t* add_device_queue(device_scheduler_t* scheduler, dev_t device, char* dir_path) {
+    scheduler->devices = realloc(
+        scheduler->devices, (scheduler->device_count + 1) * sizeof(device_queue_t));
+    if(scheduler->devices == NULL) ERR("realloc");
+
+    device_queue_t* queue = &scheduler->devices[scheduler->device_count++];
+    queue->device = device;
+    queue->dir_count = 0;
+    queue->capacity = STARTING_QUEUE_CAPACITY;
+    queue->dir_paths = malloc(queue->capacity * sizeof(char*));
+    if(queue->dir_paths == NULL) ERR("malloc");
+    queue->active_count = 0;
+    queue->is_network = is_network_filesystem(dir_path);
+    // Network mounts can occupy at most half of the threads, the rest is left for local devices
+    queue->concurrency_limit = scheduler->thread_count;
+    if(queue->is_network && scheduler->thread_count > 1)
+        queue->concurrency_limit = scheduler->thread_count / 2;
+    return queue;
+}
+
+bool is_network_filesystem(char* dir_path) {
+    struct statfs fs_stat;
+    if(statfs(dir_path, &fs_stat)) return false;
+    switch((unsigned long)fs_stat.f_type & 0xffffffffLU) {
+        case NFS_SUPER_MAGIC:
+        case SMB_SUPER_MAGIC:
+        case CIFS_SUPER_MAGIC:
+        case SMB2_SUPER_MAGIC:
+        case CEPH_SUPER_MAGIC:
+        case AFS_SUPER_MAGIC:
+        case FUSE_SUPER_MAGIC:
+            return true;
+        default:
+            return false;
+    }
+}
+
+device_queue_t* find_device_queue(device_scheduler_t* scheduler, dev_t device) {
+    for(size_t i = 0; i < scheduler->device_count; ++i)
+        if(scheduler->devices[i].device == device) return &scheduler->devices[i];
+    return NULL;
+}
+
+char* device_scheduler_pop(device_scheduler_t* scheduler, dev_t* device, bool* is_network) {
+    pthread_mutex_lock(&scheduler->mx_scheduler);
+    device_queue_t* queue;
+    while((queue = find_ready_device_queue(scheduler)) == NULL) {
+        // Nothing is queued and nothing being indexed can queue more
+        if(scheduler->is_stopped || scheduler->active_count == 0) {
+            pthread_cond_broadcast(&scheduler->cv_work_available);
+            pthread_mutex_unlock(&scheduler->mx_scheduler);
+            return NULL;
+        }
+
+        pthread_cond_wait(&scheduler->cv_work_available, &scheduler->mx_scheduler);
+    }
+
+    // Directories are taken depth-first, which keeps the queues short
+    char* dir_path = queue->dir_paths[--queue->dir_count];
+    queue->active_count += 1;
+    scheduler->active_count += 1;
+    *device = queue->device;
+    *is_network = queue->is_network;
+    pthread_mutex_unlock(&scheduler->mx_scheduler);
+    return dir_path;
+}
+
+// Devices are checked round-robin, starting after the device served last
+device_queue_t* find_ready_device_queue(device_scheduler_t* scheduler) {
+    if(scheduler->is_stopped) return NULL;
+    for(size_t i = 0; i < scheduler->device_count; ++i) {
+        size_t position = (scheduler->next_device + i) % scheduler->device_count;
+        device_queue_t* queue = &scheduler->devices[position];
+        if(queue->dir_count > 0 && queue->active_count < queue->concurrency_limit) {
+            scheduler->next_device = (position + 1) % scheduler->device_count;
+            return queue;
+        }
+    }
+
+    return NULL;
+}
+
+void device_scheduler_done(device_scheduler_t* scheduler, dev_t device) {
+    pthread_mutex_lock(&scheduler->mx_scheduler);
+    find_device_queue(scheduler, device)->active_count -= 1;
+    scheduler->active_count -= 1;
+    scheduler->done_count += 1;
+    pthread_cond_broadcast(&scheduler->cv_work_available);
+    pthread_mutex_unlock(&scheduler->mx_scheduler);
+}
+
+void device_scheduler_get_progress(
+    device_scheduler_t* scheduler,
+    size_t* done_count,
+    size_t* queued_count
+) {
+    pthread_mutex_lock(&scheduler->mx_scheduler);
+    *done_count = scheduler->done_count;
+    *queued_count = scheduler->active_count;
+    for(size_t i = 0; i < scheduler->device_count; ++i)
+        *queued_count += scheduler->devices[i].dir_count;
+    pthread_mutex_unlock(&scheduler->mx_scheduler);
+}
+
+void device_scheduler_stop(device_scheduler_t* scheduler) {
+    pthread_mutex_lock(&scheduler->mx_scheduler);
+    scheduler->is_stopped = true;
+    pthread_cond_broadcast(&scheduler->cv_work_available);
+    pthread_mutex_unlock(&scheduler->mx_scheduler);
+}
+
+void device_scheduler_destroy(device_scheduler_t* scheduler) {
+    for(size_t i = 0; i < scheduler->device_count; ++i) {
+        device_queue_t* queue = &scheduler->devices[i];
+        for(size_t j = 0; j < queue->dir_count; ++j) free(queue->dir_paths[j]);
+        free(queue->dir_paths);
+    }
+
+    free(scheduler->devices);
+    pthread_mutex_destroy(&scheduler->mx_scheduler);
+    pthread_cond_destroy(&scheduler->cv_work_available);
+}
@@ -0,0 +1,54 @@
+#ifndef DEVICE_SCHEDULER_H
+#define DEVICE_SCHEDULER_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+// Directories waiting to be indexed which reside on a single device
+typedef struct device_queue {
+    dev_t device;
+    char** dir_paths;
+    size_t dir_count;
+    size_t capacity;
+    // Number of directories of the device being indexed at the moment
+    size_t active_count;
+    size_t concurrency_limit;
+    bool is_network;
+} device_queue_t;
+
+// Hands out directories to traversal threads.
+// Every device has its own queue and concurrency limit and devices are served round-robin,
+// so threads blocked on a slow device cannot hold up the indexing of other devices.
+typedef struct device_scheduler {
+    pthread_mutex_t mx_scheduler;
+    pthread_cond_t cv_work_available;
+    device_queue_t* devices;
+    size_t device_count;
+    size_t next_device;
+    size_t active_count;
+    size_t thread_count;
+    size_t done_count;
+    bool is_stopped;
+} device_scheduler_t;
+
+void device_scheduler_init(device_scheduler_t* scheduler, size_t thread_count);
+// Takes ownership of `dir_path`
+void device_scheduler_push(device_scheduler_t* scheduler, dev_t device, char* dir_path);
+// Blocks until a directory can be indexed and returns its path, which has to be freed.
+// Returns NULL once all directories have been indexed or the scheduler has been stopped.
+// `is_network` is set if the directory resides on a network file system.
+char* device_scheduler_pop(device_scheduler_t* scheduler, dev_t* device, bool* is_network);
+// Marks a directory returned by `device_scheduler_pop` as indexed
+void device_scheduler_done(device_scheduler_t* scheduler, dev_t device);
+// Number of directories indexed so far and of those queued or being indexed
+void device_scheduler_get_progress(
+    device_scheduler_t* scheduler,
+    size_t* done_count,
+    size_t* queued_count
+);
+void device_scheduler_stop(device_scheduler_t* scheduler);
+void device_scheduler_destroy(device_scheduler_t* scheduler);
+
+#endif
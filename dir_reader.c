@@ -0,0 +1,88 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+
+#include "error.h"
+
+#include "dir_reader.h"
+
+#define STARTING_ENTRIES_CAPACITY 64LU
+
+// Layout of records returned by the getdents64 system call
+typedef struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+} linux_dirent64_t;
+
+void append_dir_entry(dir_reader_t* reader, linux_dirent64_t* record);
+bool is_dot_entry(char* name);
+int compare_inodes(const void* a, const void* b);
+
+void dir_reader_open(dir_reader_t* reader, char* dir_path, char* buffer, size_t buffer_len) {
+    reader->dir_desc = open(dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(reader->dir_desc < 0) ERR("open");
+    reader->buffer = buffer;
+    reader->buffer_len = buffer_len;
+    reader->entries_count = 0;
+    reader->entries_capacity = STARTING_ENTRIES_CAPACITY;
+    reader->entries = malloc(reader->entries_capacity * sizeof(dir_entry_t));
+    if(reader->entries == NULL) ERR("malloc");
+}
+
+bool dir_reader_read_entries(dir_reader_t* reader, bool sort_by_inode) {
+    reader->entries_count = 0;
+    // A batch consisting only of `.` and `..` is skipped
+    while(reader->entries_count == 0) {
+        long read_len =
+            syscall(SYS_getdents64, reader->dir_desc, reader->buffer, reader->buffer_len);
+        if(read_len < 0) ERR("getdents64");
+        if(read_len == 0) return false;
+
+        for(long offset = 0; offset < read_len;) {
+            linux_dirent64_t* record = (linux_dirent64_t*)(reader->buffer + offset);
+            if(!is_dot_entry(record->d_name)) append_dir_entry(reader, record);
+            offset += record->d_reclen;
+        }
+    }
+
+    if(sort_by_inode)
+        qsort(reader->entries, reader->entries_count, sizeof(dir_entry_t), compare_inodes);
+    return true;
+}
+
+void append_dir_entry(dir_reader_t* reader, linux_dirent64_t* record) {
+    if(reader->entries_count == reader->entries_capacity) {
+        reader->entries_capacity *= 2;
+        reader->entries =
+            realloc(reader->entries, reader->entries_capacity * sizeof(dir_entry_t));
+        if(reader->entries == NULL) ERR("realloc");
+    }
+
+    reader->entries[reader->entries_count++] = (dir_entry_t){
+        .inode = record->d_ino,
+        .type = record->d_type,
+        .name = record->d_name
+    };
+}
+
+bool is_dot_entry(char* name) {
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+int compare_inodes(const void* a, const void* b) {
+    ino_t ia = ((const dir_entry_t*)a)->inode;
+    ino_t ib = ((const dir_entry_t*)b)->inode;
+    return (ia > ib) - (ia < ib);
+}
+
+void dir_reader_close(dir_reader_t* reader) {
+    if(close(reader->dir_desc)) ERR("close");
+    free(reader->entries);
+    reader->entries = NULL;
+}
@@ -0,0 +1,37 @@
+#ifndef DIR_READER_H
+#define DIR_READER_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#define DIR_READ_BUFFER_LEN (512LU * 1024LU)
+
+typedef struct dir_entry {
+    ino_t inode;
+    // One of DT_* constants, DT_UNKNOWN if the file system does not report types
+    unsigned char type;
+    // Points into the reader's buffer
+    char* name;
+} dir_entry_t;
+
+// Reads directory entries with getdents64, as many at once as fit in the caller's buffer
+typedef struct dir_reader {
+    int dir_desc;
+    char* buffer;
+    size_t buffer_len;
+    dir_entry_t* entries;
+    size_t entries_count;
+    size_t entries_capacity;
+} dir_reader_t;
+
+// `buffer` is only used by this reader until it is closed
+void dir_reader_open(dir_reader_t* reader, char* dir_path, char* buffer, size_t buffer_len);
+// Replaces `entries` with the next batch of entries, without `.` and `..`.
+// Returns false if there are no entries left.
+// If `sort_by_inode` is set, the batch is ordered by inode numbers, which usually
+// follow the placement of inodes on disk.
+bool dir_reader_read_entries(dir_reader_t* reader, bool sort_by_inode);
+void dir_reader_close(dir_reader_t* reader);
+
+#endif
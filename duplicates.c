@@ -0,0 +1,285 @@
+#include <string.h>
+#include <stdint.h>
+
+#include "error.h"
+#include "file_io.h"
+
+#include "duplicates.h"
+
+typedef struct candidate {
+    off_t size;
+    size_t type;
+    uint64_t hash;
+    // Position in the index or, once collected, among the candidates
+    size_t file_id;
+    bool is_valid;
+    bool was_cached;
+    bool was_hashed;
+} candidate_t;
+
+// Argument of the hashing tasks run on the thread pool
+typedef struct hashing_job {
+    file_t* files;
+    candidate_t* candidates;
+} hashing_job_t;
+
+int compare_candidates(const void* a, const void* b);
+bool have_same_key(candidate_t* a, candidate_t* b);
+size_t keep_colliding_candidates(candidate_t* candidates, size_t count);
+void hash_candidates(
+    thread_pool_t* pool,
+    file_t* files,
+    candidate_t* candidates,
+    size_t count,
+    pool_task_t task,
+    duplicate_groups_t* groups
+);
+void prefix_hashing_task(void* void_job, size_t task_id);
+void full_hashing_task(void* void_job, size_t task_id);
+void fill_in_groups(
+    duplicate_groups_t* groups,
+    file_t* files,
+    candidate_t* candidates,
+    size_t count
+);
+int compare_hash_keys(const void* a, const void* b);
+
+// Files are first bucketed by size and type, only the colliding ones are copied
+duplicate_candidates_t collect_duplicate_candidates(index_t* index) {
+    candidate_t* candidates = malloc(index->files_count * sizeof(candidate_t));
+    if(index->files_count != 0 && candidates == NULL) ERR("malloc");
+
+    size_t count = 0;
+    for(size_t i = 0; i < index->files_count; ++i) {
+        file_t* file = &index->files[i];
+        if(file->type == FILETYPE_DIRECTORY || file->size == 0) continue;
+        candidates[count++] = (candidate_t){
+            .size = file->size,
+            .type = file->type,
+            .hash = 0,
+            .file_id = i,
+            .is_valid = true
+        };
+    }
+    count = keep_colliding_candidates(candidates, count);
+
+    duplicate_candidates_t collected = {
+        .files = malloc(count * sizeof(file_t)),
+        .file_ids = malloc(count * sizeof(size_t)),
+        .count = count
+    };
+    if(count != 0 && (collected.files == NULL || collected.file_ids == NULL)) ERR("malloc");
+    for(size_t i = 0; i < count; ++i) {
+        collected.files[i] = index->files[candidates[i].file_id];
+        collected.file_ids[i] = candidates[i].file_id;
+    }
+
+    free(candidates);
+    return collected;
+}
+
+duplicate_groups_t find_duplicates(duplicate_candidates_t* collected, thread_pool_t* pool) {
+    duplicate_groups_t groups = { .files = NULL, .group_starts = NULL, .group_count = 0 };
+    groups.prefix_hashes_computed = 0;
+    groups.full_hashes_computed = 0;
+    groups.cached_hashes_used = 0;
+    groups.stale_files = 0;
+
+    size_t count = collected->count;
+    candidate_t* candidates = malloc(count * sizeof(candidate_t));
+    if(count != 0 && candidates == NULL) ERR("malloc");
+    for(size_t i = 0; i < count; ++i) {
+        candidates[i] = (candidate_t){
+            .size = collected->files[i].size,
+            .type = collected->files[i].type,
+            .hash = 0,
+            .file_id = i,
+            .is_valid = true
+        };
+    }
+
+    file_t* files = collected->files;
+    hash_candidates(pool, files, candidates, count, prefix_hashing_task, &groups);
+    count = keep_colliding_candidates(candidates, count);
+    hash_candidates(pool, files, candidates, count, full_hashing_task, &groups);
+    count = keep_colliding_candidates(candidates, count);
+
+    fill_in_groups(&groups, files, candidates, count);
+    free(candidates);
+    return groups;
+}
+
+void store_content_hashes(duplicate_candidates_t* candidates, index_t* index) {
+    for(size_t i = 0; i < candidates->count; ++i)
+        index->files[candidates->file_ids[i]].hashes = candidates->files[i].hashes;
+}
+
+void destroy_duplicate_candidates(duplicate_candidates_t* candidates) {
+    free(candidates->files);
+    free(candidates->file_ids);
+    candidates->files = NULL;
+    candidates->file_ids = NULL;
+    candidates->count = 0;
+}
+
+int compare_candidates(const void* a, const void* b) {
+    const candidate_t* ca = a;
+    const candidate_t* cb = b;
+    if(ca->size != cb->size) return ca->size < cb->size ? -1 : 1;
+    if(ca->type != cb->type) return ca->type < cb->type ? -1 : 1;
+    if(ca->hash != cb->hash) return ca->hash < cb->hash ? -1 : 1;
+    if(ca->file_id != cb->file_id) return ca->file_id < cb->file_id ? -1 : 1;
+    return 0;
+}
+
+bool have_same_key(candidate_t* a, candidate_t* b) {
+    return a->size == b->size && a->type == b->type && a->hash == b->hash;
+}
+
+// Sorts candidates and removes the invalid ones and the ones which do not collide with any other.
+// Returns the number of candidates left
+size_t keep_colliding_candidates(candidate_t* candidates, size_t count) {
+    size_t valid_count = 0;
+    for(size_t i = 0; i < count; ++i)
+        if(candidates[i].is_valid) candidates[valid_count++] = candidates[i];
+
+    qsort(candidates, valid_count, sizeof(candidate_t), compare_candidates);
+
+    size_t kept = 0;
+    for(size_t i = 0; i < valid_count; ++i) {
+        bool collides =
+            (i > 0 && have_same_key(&candidates[i], &candidates[i - 1])) ||
+            (i + 1 < valid_count && have_same_key(&candidates[i], &candidates[i + 1]));
+        if(collides) candidates[kept++] = candidates[i];
+    }
+
+    return kept;
+}
+
+void hash_candidates(
+    thread_pool_t* pool,
+    file_t* files,
+    candidate_t* candidates,
+    size_t count,
+    pool_task_t task,
+    duplicate_groups_t* groups
+) {
+    for(size_t i = 0; i < count; ++i) {
+        candidates[i].was_cached = false;
+        candidates[i].was_hashed = false;
+    }
+
+    hashing_job_t job = { .files = files, .candidates = candidates };
+    thread_pool_run(pool, count, task, &job);
+
+    for(size_t i = 0; i < count; ++i) {
+        groups->cached_hashes_used += candidates[i].was_cached;
+        groups->stale_files += !candidates[i].is_valid;
+        if(!candidates[i].was_hashed) continue;
+        if(task == prefix_hashing_task) groups->prefix_hashes_computed += 1;
+        else groups->full_hashes_computed += 1;
+    }
+}
+
+// Every task works on a different candidate, so no synchronization is needed
+void prefix_hashing_task(void* void_job, size_t task_id) {
+    hashing_job_t* job = void_job;
+    candidate_t* candidate = &job->candidates[task_id];
+    file_t* file = &job->files[candidate->file_id];
+
+    if(file->hashes.has_prefix_hash) {
+        candidate->was_cached = true;
+        candidate->hash = file->hashes.prefix_hash;
+        return;
+    }
+
+    candidate->is_valid = try_to_hash_file_content(file, PREFIX_HASH_LEN, &candidate->hash);
+    if(!candidate->is_valid) return;
+    candidate->was_hashed = true;
+    file->hashes.prefix_hash = candidate->hash;
+    file->hashes.has_prefix_hash = true;
+    // The whole file fits into the prefix, so the prefix hash is the full hash
+    if((size_t)file->size <= PREFIX_HASH_LEN) {
+        file->hashes.full_hash = candidate->hash;
+        file->hashes.has_full_hash = true;
+    }
+}
+
+void full_hashing_task(void* void_job, size_t task_id) {
+    hashing_job_t* job = void_job;
+    candidate_t* candidate = &job->candidates[task_id];
+    file_t* file = &job->files[candidate->file_id];
+
+    if(file->hashes.has_full_hash) {
+        // Files fitting into the prefix are not counted twice
+        candidate->was_cached = (size_t)file->size > PREFIX_HASH_LEN;
+        candidate->hash = file->hashes.full_hash;
+        return;
+    }
+
+    candidate->is_valid = try_to_hash_file_content(file, SIZE_MAX, &candidate->hash);
+    if(!candidate->is_valid) return;
+    candidate->was_hashed = true;
+    file->hashes.full_hash = candidate->hash;
+    file->hashes.has_full_hash = true;
+}
+
+void fill_in_groups(
+    duplicate_groups_t* groups,
+    file_t* files,
+    candidate_t* candidates,
+    size_t count
+) {
+    groups->files = malloc(count * sizeof(file_t*));
+    // There are at most count / 2 groups, one more start marks the end of the last one
+    groups->group_starts = malloc((count / 2 + 1) * sizeof(size_t));
+    if((count != 0 && groups->files == NULL) || groups->group_starts == NULL) ERR("malloc");
+
+    for(size_t i = 0; i < count; ++i) {
+        if(i == 0 || !have_same_key(&candidates[i], &candidates[i - 1]))
+            groups->group_starts[groups->group_count++] = i;
+        groups->files[i] = &files[candidates[i].file_id];
+    }
+
+    groups->group_starts[groups->group_count] = count;
+}
+
+void destroy_duplicate_groups(duplicate_groups_t* groups) {
+    free(groups->files);
+    free(groups->group_starts);
+    groups->files = NULL;
+    groups->group_starts = NULL;
+    groups->group_count = 0;
+}
+
+void carry_over_content_hashes(index_t* old_index, index_t* new_index) {
+    file_t** hashed_files = malloc(old_index->files_count * sizeof(file_t*));
+    if(old_index->files_count != 0 && hashed_files == NULL) ERR("malloc");
+
+    size_t hashed_count = 0;
+    for(size_t i = 0; i < old_index->files_count; ++i)
+        if(old_index->files[i].hashes.has_prefix_hash)
+            hashed_files[hashed_count++] = &old_index->files[i];
+
+    qsort(hashed_files, hashed_count, sizeof(file_t*), compare_hash_keys);
+    for(size_t i = 0; i < new_index->files_count && hashed_count > 0; ++i) {
+        file_t* key = &new_index->files[i];
+        if(key->type == FILETYPE_DIRECTORY) continue;
+        file_t** match =
+            bsearch(&key, hashed_files, hashed_count, sizeof(file_t*), compare_hash_keys);
+        if(match != NULL) key->hashes = (*match)->hashes;
+    }
+
+    free(hashed_files);
+}
+
+// Orders pointers to files by the fields which decide whether their hashes are still valid
+int compare_hash_keys(const void* a, const void* b) {
+    const file_t* fa = *(file_t* const*)a;
+    const file_t* fb = *(file_t* const*)b;
+    if(fa->device != fb->device) return fa->device < fb->device ? -1 : 1;
+    if(fa->inode != fb->inode) return fa->inode < fb->inode ? -1 : 1;
+    if(fa->mtime != fb->mtime) return fa->mtime < fb->mtime ? -1 : 1;
+    if(fa->size != fb->size) return fa->size < fb->size ? -1 : 1;
+    return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef DUPLICATES_H
+#define DUPLICATES_H
+
+#include <stdlib.h>
+
+#include "index.h"
+#include "thread_pool.h"
+
+// Only this many bytes are hashed for the first comparison of same-size files
+#define PREFIX_HASH_LEN 4096LU
+
+// Copies of records of files which share their size and type with another file,
+// so that they can be hashed without holding the index
+typedef struct duplicate_candidates {
+    file_t* files;
+    // Positions of the copied records in the index they were collected from
+    size_t* file_ids;
+    size_t count;
+} duplicate_candidates_t;
+
+typedef struct duplicate_groups {
+    // Duplicated files among the candidates, grouped one after another
+    file_t** files;
+    // Group `i` consists of `files[group_starts[i]]` ... `files[group_starts[i + 1] - 1]`
+    size_t* group_starts;
+    size_t group_count;
+    size_t prefix_hashes_computed;
+    size_t full_hashes_computed;
+    size_t cached_hashes_used;
+    // Files which changed since the index has been built and were skipped
+    size_t stale_files;
+} duplicate_groups_t;
+
+duplicate_candidates_t collect_duplicate_candidates(index_t* index);
+// Hashes the candidates, cached hashes of their records are used and updated.
+// Groups point to the records of the candidates.
+duplicate_groups_t find_duplicates(duplicate_candidates_t* candidates, thread_pool_t* pool);
+// `index` has to be the same generation of the index the candidates were collected from
+void store_content_hashes(duplicate_candidates_t* candidates, index_t* index);
+void destroy_duplicate_candidates(duplicate_candidates_t* candidates);
+void destroy_duplicate_groups(duplicate_groups_t* groups);
+// Copies hashes of files which have not changed from `old_index` to `new_index`
+void carry_over_content_hashes(index_t* old_index, index_t* new_index);
+
+#endif
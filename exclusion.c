@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "error.h"
+
+#include "exclusion.h"
+
+typedef struct rule_lists {
+    char** globs;
+    size_t globs_count;
+    char** prefixes;
+    size_t prefixes_count;
+    size_t capacity;
+} rule_lists_t;
+
+bool try_to_parse_rule(char* line, rule_lists_t* lists, exclusion_rules_t* rules);
+bool is_rule_keyword(char* line, size_t keyword_len, char* keyword);
+void append_rule(char** list, size_t* count, char* value);
+bool try_to_compile_rules(rule_lists_t* lists, exclusion_rules_t* rules);
+void compile_path_prefixes(char** prefixes, size_t prefixes_count, exclusion_rules_t* rules);
+int compare_prefixes(const void* a, const void* b);
+int compare_by_components(char* a, char* b);
+bool is_path_prefix(char* prefix, char* path);
+void free_rule_list(char** list, size_t count);
+
+void init_exclusion_rules(exclusion_rules_t* rules) {
+    rules->has_name_pattern = false;
+    rules->path_prefixes = NULL;
+    rules->path_prefixes_count = 0;
+    rules->max_depth = UNLIMITED_DEPTH;
+}
+
+bool try_to_load_exclusion_rules(char* rules_path, exclusion_rules_t* rules) {
+    init_exclusion_rules(rules);
+    FILE* input = fopen(rules_path, "r");
+    if(input == NULL) {
+        fprintf(stderr, "Exclusion rules %s cannot be opened!\n", rules_path);
+        return false;
+    }
+
+    char* line = NULL;
+    size_t line_buf_len = 0;
+    size_t line_number = 0;
+    rule_lists_t lists = { .globs_count = 0, .prefixes_count = 0, .capacity = 16 };
+    lists.globs = malloc(lists.capacity * sizeof(char*));
+    lists.prefixes = malloc(lists.capacity * sizeof(char*));
+    if(lists.globs == NULL || lists.prefixes == NULL) ERR("malloc");
+
+    bool is_valid = true;
+    while(is_valid && getline(&line, &line_buf_len, input) != -1) {
+        line_number += 1;
+        line[strcspn(line, "\n")] = '\0';
+        is_valid = try_to_parse_rule(line, &lists, rules);
+        if(!is_valid)
+            fprintf(stderr, "Invalid exclusion rule in line %lu: %s\n", line_number, line);
+    }
+    if(ferror(input)) ERR("getline");
+    free(line);
+    fclose(input);
+
+    if(is_valid) is_valid = try_to_compile_rules(&lists, rules);
+    free_rule_list(lists.globs, lists.globs_count);
+    free_rule_list(lists.prefixes, lists.prefixes_count);
+    return is_valid;
+}
+
+bool try_to_parse_rule(char* line, rule_lists_t* lists, exclusion_rules_t* rules) {
+    if(line[0] == '\0' || line[0] == '#') return true;
+    char* value = strchr(line, ' ');
+    if(value == NULL || value[1] == '\0') return false;
+    size_t keyword_len = value++ - line;
+
+    // Both lists have the same capacity
+    if(lists->globs_count == lists->capacity || lists->prefixes_count == lists->capacity) {
+        lists->capacity *= 2;
+        lists->globs = realloc(lists->globs, lists->capacity * sizeof(char*));
+        lists->prefixes = realloc(lists->prefixes, lists->capacity * sizeof(char*));
+        if(lists->globs == NULL || lists->prefixes == NULL) ERR("realloc");
+    }
+
+    if(is_rule_keyword(line, keyword_len, "name"))
+        append_rule(lists->globs, &lists->globs_count, value);
+    else if(is_rule_keyword(line, keyword_len, "path") && value[0] == '/')
+        append_rule(lists->prefixes, &lists->prefixes_count, value);
+    else if(is_rule_keyword(line, keyword_len, "depth")) {
+        char* end;
+        long long depth = strtoll(value, &end, 10);
+        if(end == value || *end != '\0' || depth <= 0) return false;
+        rules->max_depth = depth;
+    }
+    else return false;
+
+    return true;
+}
+
+bool is_rule_keyword(char* line, size_t keyword_len, char* keyword) {
+    return keyword_len == strlen(keyword) && strncmp(line, keyword, keyword_len) == 0;
+}
+
+void append_rule(char** list, size_t* count, char* value) {
+    char* rule = strdup(value);
+    if(rule == NULL) ERR("strdup");
+    list[(*count)++] = rule;
+}
+
+bool try_to_compile_rules(rule_lists_t* lists, exclusion_rules_t* rules) {
+    if(lists->globs_count > 0) {
+        if(!try_to_compile_glob_set(lists->globs, lists->globs_count, &rules->name_pattern))
+            return false;
+        rules->has_name_pattern = true;
+    }
+
+    compile_path_prefixes(lists->prefixes, lists->prefixes_count, rules);
+    return true;
+}
+
+// Prefixes are ordered with `/` before every other byte, so every path directly follows
+// its ancestors and their other descendants. Prefixes covered by other prefixes are dropped,
+// so that the only prefix which can match a path is the greatest prefix not greater than it.
+void compile_path_prefixes(char** prefixes, size_t prefixes_count, exclusion_rules_t* rules) {
+    if(prefixes_count == 0) return;
+    qsort(prefixes, prefixes_count, sizeof(char*), compare_prefixes);
+    rules->path_prefixes = malloc(prefixes_count * sizeof(char*));
+    if(rules->path_prefixes == NULL) ERR("malloc");
+
+    for(size_t i = 0; i < prefixes_count; ++i) {
+        size_t count = rules->path_prefixes_count;
+        if(count > 0 && is_path_prefix(rules->path_prefixes[count - 1], prefixes[i])) continue;
+        rules->path_prefixes[count] = strdup(prefixes[i]);
+        if(rules->path_prefixes[count] == NULL) ERR("strdup");
+        rules->path_prefixes_count += 1;
+    }
+}
+
+int compare_prefixes(const void* a, const void* b) {
+    return compare_by_components(*(char* const*)a, *(char* const*)b);
+}
+
+int compare_by_components(char* a, char* b) {
+    while(*a != '\0' && *a == *b) {
+        ++a;
+        ++b;
+    }
+
+    if(*a == *b) return 0;
+    if(*a == '\0') return -1;
+    if(*b == '\0') return 1;
+    if(*a == '/') return -1;
+    if(*b == '/') return 1;
+    return (unsigned char)*a - (unsigned char)*b;
+}
+
+// Prefixes only match whole components, `/srv/build` does not match `/srv/buildroot`
+bool is_path_prefix(char* prefix, char* path) {
+    size_t prefix_len = strlen(prefix);
+    if(strncmp(prefix, path, prefix_len) != 0) return false;
+    return path[prefix_len] == '\0' || path[prefix_len] == '/' || prefix[prefix_len - 1] == '/';
+}
+
+void free_rule_list(char** list, size_t count) {
+    for(size_t i = 0; i < count; ++i) free(list[i]);
+    free(list);
+}
+
+bool has_exclusion_rules(exclusion_rules_t* rules) {
+    return
+        rules->has_name_pattern ||
+        rules->path_prefixes_count > 0 ||
+        rules->max_depth != UNLIMITED_DEPTH;
+}
+
+bool is_entry_excluded(exclusion_rules_t* rules, char* name, char* path) {
+    if(rules->has_name_pattern && pattern_matches(&rules->name_pattern, name)) return true;
+    if(rules->path_prefixes_count == 0) return false;
+
+    // Binary search for the greatest prefix not greater than the path
+    size_t low = 0, high = rules->path_prefixes_count;
+    while(low < high) {
+        size_t middle = low + (high - low) / 2;
+        if(compare_by_components(rules->path_prefixes[middle], path) <= 0) low = middle + 1;
+        else high = middle;
+    }
+
+    return low > 0 && is_path_prefix(rules->path_prefixes[low - 1], path);
+}
+
+bool is_depth_excluded(exclusion_rules_t* rules, size_t depth) {
+    return rules->max_depth != UNLIMITED_DEPTH && depth > rules->max_depth;
+}
+
+void destroy_exclusion_rules(exclusion_rules_t* rules) {
+    if(rules->has_name_pattern) destroy_pattern(&rules->name_pattern);
+    free_rule_list(rules->path_prefixes, rules->path_prefixes_count);
+    init_exclusion_rules(rules);
+}
@@ -0,0 +1,45 @@
+#ifndef EXCLUSION_H
+#define EXCLUSION_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "pattern.h"
+
+#define UNLIMITED_DEPTH -1LU
+
+// Rules pruning files and whole subtrees from indexing, compiled once at startup.
+// Excluded directories are neither indexed nor opened.
+typedef struct exclusion_rules {
+    // Set if there is at least one name glob, all of them are compiled into `name_pattern`
+    bool has_name_pattern;
+    pattern_t name_pattern;
+    // Sorted, none of them is a prefix of another one
+    char** path_prefixes;
+    size_t path_prefixes_count;
+    // Directories at this depth below the indexed directory are indexed, but not descended into
+    size_t max_depth;
+} exclusion_rules_t;
+
+// Numbers of entries skipped during a single indexing
+typedef struct exclusion_counts {
+    // Directory entries matching a name glob or a path prefix
+    size_t excluded_entries;
+    // Directories not descended into because of the maximum depth
+    size_t pruned_dirs;
+} exclusion_counts_t;
+
+// Rules which do not exclude anything
+void init_exclusion_rules(exclusion_rules_t* rules);
+// Every line of the file is a rule: `name glob`, `path prefix` or `depth n`,
+// empty lines and lines starting with `#` are skipped.
+// Returns false and prints the reason if the file cannot be read or is invalid.
+bool try_to_load_exclusion_rules(char* rules_path, exclusion_rules_t* rules);
+bool has_exclusion_rules(exclusion_rules_t* rules);
+// `path` is the absolute path of the entry `name`
+bool is_entry_excluded(exclusion_rules_t* rules, char* name, char* path);
+// `depth` of children of the indexed directory is 1
+bool is_depth_excluded(exclusion_rules_t* rules, size_t depth);
+void destroy_exclusion_rules(exclusion_rules_t* rules);
+
+#endif
@@ -3,15 +3,34 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <stdint.h>
 
 #include "error.h"
+#include "hash.h"
+#include "rollup.h"
 
 #include "file_io.h"
 
+// Bumped whenever the layout of `file_t` or of the index file changes
+#define INDEX_FILE_VERSION 8LU
+#define INDEX_FILE_MAGIC "MAULWURF"
+#define REJECTS_FILE_MAGIC "MWREJECT"
+// Multiple of HASH_STRIPE_LEN, so that only the last chunk of a file has an incomplete stripe
+#define HASHING_BUFFER_LEN 65536LU
+#define BUILDING_INDEX_SUFFIX ".building"
+#define REJECTS_SUFFIX ".rejects"
+#define TEMPORARY_FILE_SUFFIX ".XXXXXX"
+
+typedef struct index_file_header {
+    char magic[sizeof(INDEX_FILE_MAGIC) - 1];
+    uint64_t version;
+    uint64_t files_count;
+} index_file_header_t;
+
 typedef ssize_t (*file_operator_t) (int file_descriptor, void* buffer, size_t bytes_left);
 
-ssize_t bulk_read(int file_descriptor, char *buffer, size_t bytes_left);
-ssize_t bulk_write(int file_descriptor, char *buffer, size_t bytes_left);
 ssize_t generic_bulk_file_operation(
     int file_descriptor,
     char* buffer,
@@ -19,19 +38,62 @@ ssize_t generic_bulk_file_operation(
     file_operator_t operator
 );
 void set_index_creation_time(char* file_name, index_t* index);
+bool is_header_valid(index_file_header_t* header, ssize_t header_size, char* magic);
+bool try_to_write_header(int file_desc, char* magic, size_t count);
+void read_index_records(int file_desc, index_t* index);
+bool try_to_map_index_records(int file_desc, index_t* index, int protection, int flags);
+char* append_to_path(char* path, char* suffix);
+bool has_file_changed(int file_desc, file_t* file);
 
-size_t read_file_signature(char* path, char* signature, size_t max_size) {
+// If `drop_cache` is set, the kernel is advised to drop the file's pages from the page cache
+size_t read_file_signature(char* path, char* signature, size_t max_size, bool drop_cache) {
     int file_desc = open(path, O_RDONLY);
     if(file_desc < 0) ERR("open");
     ssize_t read_size = bulk_read(file_desc, signature, max_size);
     if(read_size < 0) ERR("read");
+    if(drop_cache) posix_fadvise(file_desc, 0, 0, POSIX_FADV_DONTNEED);
     if(close(file_desc)) ERR("close");
     return read_size;
 }
 
-void load_index_from_file(char* file_name, index_t** index) {
+// Hashes at most `max_len` first bytes of the file.
+// Returns false if the file no longer exists or has changed since it has been indexed
+bool try_to_hash_file_content(file_t* file, size_t max_len, uint64_t* hash) {
+    int file_desc = open(file->path, O_RDONLY);
+    if(file_desc < 0) {
+        if(errno == ENOENT || errno == EACCES) return false;
+        ERR("open");
+    }
+
+    if(has_file_changed(file_desc, file)) {
+        if(close(file_desc)) ERR("close");
+        return false;
+    }
+
+    char* buffer = malloc(HASHING_BUFFER_LEN);
+    if(buffer == NULL) ERR("malloc");
+    hash_state_t state;
+    hash_init(&state);
+    ssize_t read_size;
+    size_t consumed = 0;
+    do {
+        size_t to_read = max_len - consumed < HASHING_BUFFER_LEN ?
+            max_len - consumed : HASHING_BUFFER_LEN;
+        read_size = bulk_read(file_desc, buffer, to_read);
+        if(read_size < 0) ERR("read");
+        consumed += hash_update(&state, buffer, read_size);
+    } while((size_t)read_size == HASHING_BUFFER_LEN && consumed < max_len);
+
+    size_t tail_len = read_size % HASH_STRIPE_LEN;
+    *hash = hash_final(&state, buffer + read_size - tail_len, tail_len);
+    free(buffer);
+    if(close(file_desc)) ERR("close");
+    return true;
+}
+
+void load_index_from_file(char* file_name, index_t** index, bool should_map) {
     errno = 0;
-    int file_desc = open(file_name, O_RDONLY);
+    int file_desc = open(file_name, should_map ? O_RDWR : O_RDONLY);
     if(file_desc < 0) {
         if(errno == ENOENT) {
             *index = NULL;
@@ -41,19 +103,193 @@ void load_index_from_file(char* file_name, index_t** index) {
         ERR("open");
     }
 
-    bulk_read(file_desc, (char*)&(*index)->files_count, sizeof((*index)->files_count));
-    (*index)->files = malloc(sizeof(file_t) * (*index)->files_count);
-    bulk_read(file_desc, (char*)(*index)->files, sizeof(file_t) * (*index)->files_count);
+    index_file_header_t header;
+    ssize_t header_size = bulk_read(file_desc, (char*)&header, sizeof(header));
+    if(!is_header_valid(&header, header_size, INDEX_FILE_MAGIC)) {
+        fprintf(stderr, "Index file %s has an incompatible format, rebuilding it\n", file_name);
+        if(close(file_desc)) ERR("close");
+        *index = NULL;
+        return;
+    }
+
+    (*index)->files_count = header.files_count;
+    (*index)->generation = 0;
+    (*index)->is_partial = false;
+    (*index)->excluded = (exclusion_counts_t){ .excluded_entries = 0, .pruned_dirs = 0 };
+    if(!should_map) read_index_records(file_desc, *index);
+    else if(!try_to_map_index_records(file_desc, *index, PROT_READ | PROT_WRITE, MAP_SHARED)) {
+        fprintf(stderr, "Index file %s is truncated, rebuilding it\n", file_name);
+        if(close(file_desc)) ERR("close");
+        *index = NULL;
+        return;
+    }
+    (*index)->is_file_mapped = should_map;
+    (*index)->root_rollup = sum_top_level_rollups(*index);
+
     set_index_creation_time(file_name, *index);
     if(close(file_desc)) ERR("close");
 }
 
+void read_index_records(int file_desc, index_t* index) {
+    index->mapping = NULL;
+    index->mapping_size = 0;
+    index->is_file_mapped = false;
+    index->files = malloc(sizeof(file_t) * index->files_count);
+    if(index->files_count != 0 && index->files == NULL) ERR("malloc");
+    bulk_read(file_desc, (char*)index->files, sizeof(file_t) * index->files_count);
+}
+
+// Records are only paged in when accessed. With MAP_SHARED,
+// content hashes written to the records end up in the index file.
+bool try_to_map_index_records(int file_desc, index_t* index, int protection, int flags) {
+    struct stat filestat;
+    if(fstat(file_desc, &filestat)) ERR("fstat");
+    size_t mapping_size = sizeof(index_file_header_t) + sizeof(file_t) * index->files_count;
+    if((size_t)filestat.st_size != mapping_size) return false;
+
+    void* mapping = mmap(NULL, mapping_size, protection, flags, file_desc, 0);
+    if(mapping == MAP_FAILED) ERR("mmap");
+    index->mapping = mapping;
+    index->mapping_size = mapping_size;
+    index->files = (file_t*)((char*)mapping + sizeof(index_file_header_t));
+    return true;
+}
+
 void save_index_to_file(char* file_name, index_t* index) {
+    if(index->is_file_mapped) {
+        if(msync(index->mapping, index->mapping_size, MS_SYNC)) ERR("msync");
+        return;
+    }
+
     int file_desc = open(file_name, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0666);
     if(file_desc < 0) ERR("open");
-    bulk_write(file_desc, (char*)&index->files_count, sizeof(index->files_count));
-    bulk_write(file_desc, (char*)index->files, sizeof(index->files[0]) * index->files_count);
+    if(!try_to_write_index_to_desc(file_desc, index)) ERR("write");
+    if(close(file_desc)) ERR("close");
+}
+
+bool try_to_write_index_to_desc(int file_desc, index_t* index) {
+    if(!try_to_write_header(file_desc, INDEX_FILE_MAGIC, index->files_count)) return false;
+    size_t size = sizeof(index->files[0]) * index->files_count;
+    return bulk_write(file_desc, (char*)index->files, size) == (ssize_t)size;
+}
+
+// Records modified later are copied on write, so other mappings of the file never see them
+bool try_to_map_written_index(int file_desc, index_t* index) {
+    file_t* files = index->files;
+    if(!try_to_map_index_records(file_desc, index, PROT_READ | PROT_WRITE, MAP_PRIVATE))
+        return false;
+    index->is_file_mapped = false;
+    free(files);
+    return true;
+}
+
+bool try_to_map_read_only_index(int file_desc, index_t* index) {
+    index_file_header_t header;
+    ssize_t header_size = pread(file_desc, &header, sizeof(header), 0);
+    if(header_size < 0) ERR("pread");
+    if(!is_header_valid(&header, header_size, INDEX_FILE_MAGIC)) return false;
+
+    index->files_count = header.files_count;
+    index->generation = 0;
+    index->is_partial = false;
+    index->excluded = (exclusion_counts_t){ .excluded_entries = 0, .pruned_dirs = 0 };
+    if(!try_to_map_index_records(file_desc, index, PROT_READ, MAP_SHARED)) return false;
+    index->is_file_mapped = false;
+    index->root_rollup = sum_top_level_rollups(index);
+
+    struct stat filestat;
+    if(fstat(file_desc, &filestat)) ERR("fstat");
+    index->creation_time = filestat.st_mtime;
+    return true;
+}
+
+char* get_building_index_path(char* index_path) {
+    return append_to_path(index_path, BUILDING_INDEX_SUFFIX);
+}
+
+// The previous index file is replaced atomically, so a mapping of it stays valid
+void publish_built_index(char* index_path, index_t* index) {
+    save_index_to_file(index_path, index);
+    char* building_path = get_building_index_path(index_path);
+    if(rename(building_path, index_path)) ERR("rename");
+    free(building_path);
+}
+
+void write_index_header(int file_desc, size_t files_count) {
+    if(!try_to_write_header(file_desc, INDEX_FILE_MAGIC, files_count)) ERR("write");
+}
+
+// Index and rejects files share the header layout and version
+bool try_to_write_header(int file_desc, char* magic, size_t count) {
+    index_file_header_t header = {
+        .version = INDEX_FILE_VERSION,
+        .files_count = count
+    };
+    memcpy(header.magic, magic, sizeof(header.magic));
+    return bulk_write(file_desc, (char*)&header, sizeof(header)) == sizeof(header);
+}
+
+char* get_rejects_path(char* index_path) {
+    return append_to_path(index_path, REJECTS_SUFFIX);
+}
+
+rejected_file_t* load_rejected_files_from_file(char* file_name, size_t* count) {
+    *count = 0;
+    errno = 0;
+    int file_desc = open(file_name, O_RDONLY);
+    if(file_desc < 0) {
+        if(errno == ENOENT) return NULL;
+        ERR("open");
+    }
+
+    index_file_header_t header;
+    ssize_t header_size = bulk_read(file_desc, (char*)&header, sizeof(header));
+    rejected_file_t* rejects = NULL;
+    if(is_header_valid(&header, header_size, REJECTS_FILE_MAGIC)) {
+        size_t size = header.files_count * sizeof(rejected_file_t);
+        rejects = malloc(size);
+        if(size != 0 && rejects == NULL) ERR("malloc");
+        if(bulk_read(file_desc, (char*)rejects, size) == (ssize_t)size) *count = header.files_count;
+        else {
+            free(rejects);
+            rejects = NULL;
+        }
+    }
+
+    if(close(file_desc)) ERR("close");
+    return rejects;
+}
+
+// Like built indices, rejects are written next to the file and replace it atomically,
+// so an interrupted save leaves the previous rejects intact
+void save_rejected_files_to_file(char* file_name, rejected_file_t* rejects, size_t count) {
+    char* building_path = append_to_path(file_name, BUILDING_INDEX_SUFFIX);
+    int file_desc = open(building_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(file_desc < 0) ERR("open");
+    if(!try_to_write_header(file_desc, REJECTS_FILE_MAGIC, count)) ERR("write");
+    size_t size = count * sizeof(rejected_file_t);
+    if(bulk_write(file_desc, (char*)rejects, size) != (ssize_t)size) ERR("write");
     if(close(file_desc)) ERR("close");
+    if(rename(building_path, file_name)) ERR("rename");
+    free(building_path);
+}
+
+int open_temporary_file(char* path_prefix) {
+    char* path = append_to_path(path_prefix, TEMPORARY_FILE_SUFFIX);
+    int file_desc = mkstemp(path);
+    if(file_desc < 0) ERR("mkstemp");
+    if(unlink(path)) ERR("unlink");
+    free(path);
+    return file_desc;
+}
+
+char* append_to_path(char* path, char* suffix) {
+    size_t path_len = strlen(path);
+    char* result = malloc(path_len + strlen(suffix) + 1);
+    if(result == NULL) ERR("malloc");
+    memcpy(result, path, path_len);
+    strcpy(result + path_len, suffix);
+    return result;
 }
 
 ssize_t bulk_read(int file_descriptor, char *buffer, size_t bytes_left) {
@@ -91,3 +327,20 @@ void set_index_creation_time(char* file_name, index_t* index) {
     if(lstat(file_name, &filestat)) ERR("lstat");
     index->creation_time = filestat.st_mtime;
 }
+
+bool is_header_valid(index_file_header_t* header, ssize_t header_size, char* magic) {
+    return
+        header_size == sizeof(*header) &&
+        memcmp(header->magic, magic, sizeof(header->magic)) == 0 &&
+        header->version == INDEX_FILE_VERSION;
+}
+
+bool has_file_changed(int file_desc, file_t* file) {
+    struct stat filestat;
+    if(fstat(file_desc, &filestat)) ERR("fstat");
+    return
+        filestat.st_dev != file->device ||
+        filestat.st_ino != file->inode ||
+        filestat.st_mtime != file->mtime ||
+        filestat.st_size != file->size;
+}
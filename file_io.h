@@ -2,11 +2,40 @@
 #define FILE_IO_H
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <sys/types.h>
 
 #include "index.h"
+#include "signature_cache.h"
 
-size_t read_file_signature(char* path, char* signature, size_t max_size);
-void load_index_from_file(char* file_name, index_t** index);
+size_t read_file_signature(char* path, char* signature, size_t max_size, bool drop_cache);
+// If `should_map` is set, the index is served from the mapped file instead of being read
+void load_index_from_file(char* file_name, index_t** index, bool should_map);
+// Mapped indices are backed by their file, saving them only flushes modified records
 void save_index_to_file(char* file_name, index_t* index);
+// Writes the index in the format of index files at the current offset,
+// returns false if it has not been written completely
+bool try_to_write_index_to_desc(int file_desc, index_t* index);
+// Replaces records of an index held in memory by a private mapping of the same index
+// written to `file_desc`, returns false if it cannot be mapped
+bool try_to_map_written_index(int file_desc, index_t* index);
+// Maps an index written by `try_to_write_index_to_desc` without write access,
+// returns false if it is invalid or truncated
+bool try_to_map_read_only_index(int file_desc, index_t* index);
+// Path at which bounded builds write the next index before it is published, has to be freed
+char* get_building_index_path(char* index_path);
+// Replaces the index file with the mapped index built at `get_building_index_path(index_path)`
+void publish_built_index(char* index_path, index_t* index);
+void write_index_header(int file_desc, size_t files_count);
+// Path of the file with files rejected by the last indexing, has to be freed
+char* get_rejects_path(char* index_path);
+// Returns NULL and sets `count` to 0 if the file does not exist or is invalid
+rejected_file_t* load_rejected_files_from_file(char* file_name, size_t* count);
+void save_rejected_files_to_file(char* file_name, rejected_file_t* rejects, size_t count);
+// Opens a temporary file next to `path_prefix`, which is removed as soon as it is closed
+int open_temporary_file(char* path_prefix);
+ssize_t bulk_read(int file_descriptor, char *buffer, size_t bytes_left);
+ssize_t bulk_write(int file_descriptor, char *buffer, size_t bytes_left);
+bool try_to_hash_file_content(file_t* file, size_t max_len, uint64_t* hash);
 
 #endif
@@ -0,0 +1,113 @@
+#include <string.h>
+
+#include "hash.h"
+
+#define PRIME_1 0x9E3779B185EBCA87LLU
+#define PRIME_2 0xC2B2AE3D27D4EB4FLLU
+#define PRIME_3 0x165667B19E3779F9LLU
+#define PRIME_4 0x85EBCA77C2B2AE63LLU
+#define PRIME_5 0x27D4EB2F165667C5LLU
+
+uint64_t rotate_left(uint64_t value, int bits);
+uint64_t read_u64(const char* data);
+uint32_t read_u32(const char* data);
+uint64_t hash_round(uint64_t accumulator, uint64_t input);
+uint64_t hash_merge_round(uint64_t accumulator, uint64_t lane);
+uint64_t hash_avalanche(uint64_t hash);
+
+void hash_init(hash_state_t* state) {
+    state->lanes[0] = PRIME_1 + PRIME_2;
+    state->lanes[1] = PRIME_2;
+    state->lanes[2] = 0;
+    state->lanes[3] = -PRIME_1;
+    state->total_len = 0;
+}
+
+size_t hash_update(hash_state_t* state, const char* data, size_t len) {
+    size_t consumed = 0;
+    while(len - consumed >= HASH_STRIPE_LEN) {
+        for(size_t i = 0; i < 4; ++i)
+            state->lanes[i] = hash_round(state->lanes[i], read_u64(data + consumed + 8 * i));
+        consumed += HASH_STRIPE_LEN;
+    }
+
+    state->total_len += consumed;
+    return consumed;
+}
+
+uint64_t hash_final(hash_state_t* state, const char* tail, size_t tail_len) {
+    uint64_t hash;
+    if(state->total_len >= HASH_STRIPE_LEN) {
+        hash =
+            rotate_left(state->lanes[0], 1) + rotate_left(state->lanes[1], 7) +
+            rotate_left(state->lanes[2], 12) + rotate_left(state->lanes[3], 18);
+        for(size_t i = 0; i < 4; ++i)
+            hash = hash_merge_round(hash, state->lanes[i]);
+    }
+    else hash = PRIME_5;
+
+    hash += state->total_len + tail_len;
+
+    for(; tail_len >= 8; tail += 8, tail_len -= 8) {
+        hash ^= hash_round(0, read_u64(tail));
+        hash = rotate_left(hash, 27) * PRIME_1 + PRIME_4;
+    }
+
+    if(tail_len >= 4) {
+        hash ^= (uint64_t)read_u32(tail) * PRIME_1;
+        hash = rotate_left(hash, 23) * PRIME_2 + PRIME_3;
+        tail += 4;
+        tail_len -= 4;
+    }
+
+    for(; tail_len > 0; ++tail, --tail_len) {
+        hash ^= (uint64_t)(unsigned char)*tail * PRIME_5;
+        hash = rotate_left(hash, 11) * PRIME_1;
+    }
+
+    return hash_avalanche(hash);
+}
+
+uint64_t hash_buffer(const char* data, size_t len) {
+    hash_state_t state;
+    hash_init(&state);
+    size_t consumed = hash_update(&state, data, len);
+    return hash_final(&state, data + consumed, len - consumed);
+}
+
+uint64_t rotate_left(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Data is read through memcpy, so that unaligned buffers can be hashed
+uint64_t read_u64(const char* data) {
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+uint32_t read_u32(const char* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+uint64_t hash_round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * PRIME_2;
+    accumulator = rotate_left(accumulator, 31);
+    return accumulator * PRIME_1;
+}
+
+uint64_t hash_merge_round(uint64_t accumulator, uint64_t lane) {
+    accumulator ^= hash_round(0, lane);
+    return accumulator * PRIME_1 + PRIME_4;
+}
+
+uint64_t hash_avalanche(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
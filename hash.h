@@ -0,0 +1,23 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+// Fast non-cryptographic 64-bit hash following the xxHash64 construction.
+// Data is consumed in 32 byte stripes, so it can be fed from a file in chunks.
+#define HASH_STRIPE_LEN 32LU
+
+typedef struct hash_state {
+    uint64_t lanes[4];
+    uint64_t total_len;
+} hash_state_t;
+
+void hash_init(hash_state_t* state);
+// Consumes all full stripes of `data`, returns the number of bytes consumed
+size_t hash_update(hash_state_t* state, const char* data, size_t len);
+// Consumes the remaining (shorter than a stripe) tail and returns the final hash
+uint64_t hash_final(hash_state_t* state, const char* tail, size_t tail_len);
+uint64_t hash_buffer(const char* data, size_t len);
+
+#endif
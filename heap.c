@@ -0,0 +1,83 @@
+#include <stdbool.h>
+
+#include "error.h"
+
+#include "heap.h"
+
+void sift_up(bounded_heap_t* heap, size_t position);
+void sift_down(bounded_heap_t* heap, size_t position, size_t count);
+// True if `a` should be closer to the root than `b`, which means that `a` comes later in order
+bool is_worse(bounded_heap_t* heap, void* a, void* b);
+void swap_items(void** items, size_t a, size_t b);
+
+void bounded_heap_init(bounded_heap_t* heap, size_t capacity, heap_compare_t compare) {
+    heap->items = malloc(capacity * sizeof(void*));
+    if(capacity != 0 && heap->items == NULL) ERR("malloc");
+    heap->count = 0;
+    heap->capacity = capacity;
+    heap->compare = compare;
+}
+
+void bounded_heap_push(bounded_heap_t* heap, void* item) {
+    if(heap->count < heap->capacity) {
+        heap->items[heap->count] = item;
+        sift_up(heap, heap->count++);
+    }
+    else if(heap->count > 0 && is_worse(heap, heap->items[0], item)) {
+        heap->items[0] = item;
+        sift_down(heap, 0, heap->count);
+    }
+}
+
+void** bounded_heap_take_sorted(bounded_heap_t* heap, size_t* count) {
+    // Heapsort: the worst item is moved to the end until the heap is empty
+    for(size_t remaining = heap->count; remaining > 1; --remaining) {
+        swap_items(heap->items, 0, remaining - 1);
+        sift_down(heap, 0, remaining - 1);
+    }
+
+    void** items = heap->items;
+    *count = heap->count;
+    heap->items = NULL;
+    heap->count = 0;
+    heap->capacity = 0;
+    return items;
+}
+
+void sift_up(bounded_heap_t* heap, size_t position) {
+    while(position > 0) {
+        size_t parent = (position - 1) / 2;
+        if(!is_worse(heap, heap->items[position], heap->items[parent])) return;
+        swap_items(heap->items, position, parent);
+        position = parent;
+    }
+}
+
+void sift_down(bounded_heap_t* heap, size_t position, size_t count) {
+    for(;;) {
+        size_t worst = position;
+        size_t left = 2 * position + 1;
+        size_t right = left + 1;
+        if(left < count && is_worse(heap, heap->items[left], heap->items[worst])) worst = left;
+        if(right < count && is_worse(heap, heap->items[right], heap->items[worst])) worst = right;
+        if(worst == position) return;
+        swap_items(heap->items, position, worst);
+        position = worst;
+    }
+}
+
+bool is_worse(bounded_heap_t* heap, void* a, void* b) {
+    return heap->compare(&a, &b) > 0;
+}
+
+void swap_items(void** items, size_t a, size_t b) {
+    void* tmp = items[a];
+    items[a] = items[b];
+    items[b] = tmp;
+}
+
+void bounded_heap_destroy(bounded_heap_t* heap) {
+    free(heap->items);
+    heap->items = NULL;
+    heap->count = 0;
+}
@@ -0,0 +1,25 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <stdlib.h>
+
+// qsort-style comparator of two `void*` items, receives pointers to them
+typedef int (*heap_compare_t) (const void* a, const void* b);
+
+// Keeps the `capacity` items which come first in the order defined by `compare`.
+// The root is the worst item kept, so every push costs O(log capacity).
+typedef struct bounded_heap {
+    void** items;
+    size_t count;
+    size_t capacity;
+    heap_compare_t compare;
+} bounded_heap_t;
+
+void bounded_heap_init(bounded_heap_t* heap, size_t capacity, heap_compare_t compare);
+void bounded_heap_push(bounded_heap_t* heap, void* item);
+// Sorts the kept items in the order defined by `compare`, the heap is empty afterwards.
+// Returns the items, which have to be freed by the caller.
+void** bounded_heap_take_sorted(bounded_heap_t* heap, size_t* count);
+void bounded_heap_destroy(bounded_heap_t* heap);
+
+#endif
@@ -1,56 +1,121 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <errno.h>
 #include <sys/stat.h>
 #include <string.h>
 #include <stdbool.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/sysmacros.h>
 
 #include "error.h"
 #include "file_io.h"
 #include "interactive.h"
+#include "duplicates.h"
+#include "index_builder.h"
+#include "device_scheduler.h"
+#include "thread_pool.h"
+#include "dir_reader.h"
+#include "signature_cache.h"
+#include "rollup.h"
+#include "case_fold.h"
 
 #include "index.h"
 
-#define STARTING_INDEX_SIZE 16
+// Device numbers are always returned by statx
+#define INDEXED_STATX_MASK \
+    (STATX_TYPE | STATX_SIZE | STATX_UID | STATX_INO | STATX_MTIME | STATX_CTIME)
+// Files of a directory are added to the index in batches of this size
+#define DIR_BATCH_LEN 64LU
+// Minimal seconds between the end of a snapshot of the index being built and the next one
+#define SNAPSHOT_INTERVAL 5.0
+// Snapshots copy and sort all records collected so far, so at most a fifth of the time
+// of indexing is spent on them
+#define SNAPSHOT_COST_FACTOR 4.0
 
 typedef struct partial_indexing_data {
-    index_t index;
+    index_builder_t builder;
+    device_scheduler_t scheduler;
+    signature_cache_t signature_cache;
     filetype_t* filetypes;
     size_t filetypes_count;
+    size_t max_signature_len;
     pthread_mutex_t* mx_indexing_shutdown;
+    throttle_t* throttle;
+    bool one_file_system;
+    bool sort_by_inode;
+    bool network_dont_sync;
+    dev_t root_device;
+    size_t root_path_len;
+    exclusion_rules_t* exclusion_rules;
+    pthread_mutex_t mx_exclusions;
+    exclusion_counts_t excluded;
+    snapshot_publisher_t publish_snapshot;
+    void* snapshot_arg;
+    pthread_mutex_t mx_snapshot;
+    struct timespec last_snapshot_end;
+    // Grows with the duration of snapshots
+    double snapshot_interval;
 } partial_indexing_data_t;
 
+// Directory being indexed
+typedef struct open_dir {
+    // Absolute path without symbolic links
+    char* path;
+    int desc;
+    // Flags of statx calls for files in the directory
+    int stat_flags;
+} open_dir_t;
+
+// Files found in the directory being indexed which have not been added to the index yet
+typedef struct dir_batch {
+    file_t* files;
+    size_t files_count;
+    // Entries of the directory skipped by exclusion rules
+    exclusion_counts_t excluded;
+} dir_batch_t;
+
 size_t get_max_signature_len(filetype_t* filetypes, size_t filetypes_count);
-bool try_to_add_next_dir_entry(
-    char* dir_path,
+void traverse_directories(void* void_indexing_data, size_t thread_id);
+void publish_snapshot_if_due(partial_indexing_data_t* indexing_data);
+void add_dir_entry(
+    open_dir_t* dir,
     partial_indexing_data_t* indexing_data,
-    DIR* dir,
-    size_t* files_buf_size,
-    size_t max_signature_len
+    dir_entry_t* entry,
+    dir_batch_t* batch
 );
+bool should_descend(partial_indexing_data_t* indexing_data, file_t* dir, dir_batch_t* batch);
+size_t get_dir_depth(partial_indexing_data_t* indexing_data, char* path);
+void add_exclusion_counts(partial_indexing_data_t* indexing_data, exclusion_counts_t* counts);
 bool should_stop_indexing(pthread_mutex_t* mx_indexing_shutdown);
 char* get_file_path(char* dir_path, char* filename);
-void reallocate_files_buffer(index_t* index, size_t* files_buf_size);
 void load_dir_to_index(
     char* path,
+    bool is_network,
     partial_indexing_data_t* indexing_data,
-    size_t* files_buf_size,
-    size_t max_signature_len
+    char* read_buffer
 );
 bool add_next_file_if_matches(
     partial_indexing_data_t* indexing_data,
+    file_t* file,
+    open_dir_t* dir,
     char* path,
-    char* name,
-    size_t max_signature_len
+    char* name
 );
 bool try_to_fill_in_stat_data(
     file_t* file,
+    open_dir_t* dir,
+    char* name,
     char* path,
-    filetype_t* filetypes,
-    size_t filetypes_count,
-    size_t max_signature_len
+    partial_indexing_data_t* indexing_data
+);
+size_t get_cached_regular_filetype(
+    file_t* file,
+    char* path,
+    partial_indexing_data_t* indexing_data
 );
 void fill_in_name_data(file_t* file, char* name);
 void fill_in_path_data(file_t* file, char* path);
@@ -58,59 +123,192 @@ size_t get_regular_filetype(
     char* path,
     filetype_t* filetypes,
     size_t filetypes_count,
-    size_t max_signature_len
+    size_t max_signature_len,
+    throttle_t* throttle
 );
 bool does_match_any_signature(filetype_t* filetype, char* signature, size_t signature_len);
-void swap_indices(char* index_path,
-    index_t* old_index,
-    index_t* new_index,
-    pthread_mutex_t* mx_index
-);
+double get_seconds_since(struct timespec* start);
+void swap_indices(indexing_data_t* data, index_t* new_index, index_diff_t* diff);
+void print_indexing_completion(throttle_t* throttle);
+void print_exclusion_counts(exclusion_rules_t* rules, exclusion_counts_t* counts);
+void publish_partial_index(index_t* snapshot, indexing_progress_t* progress, void* arg);
 
-index_t create_index(
+bool try_to_create_index(
     char *dir_path,
     filetype_t* filetypes,
     size_t filetypes_count,
-    pthread_mutex_t* mx_indexing_shutdown
+    pthread_mutex_t* mx_indexing_shutdown,
+    indexing_options_t* options,
+    index_t* index
 ) {
-    size_t files_buf_size = STARTING_INDEX_SIZE;
+    struct stat root_stat;
+    if(stat(dir_path, &root_stat)) ERR("stat");
     partial_indexing_data_t indexing_data = {
-        .index = {
-            .files_count = 0,
-            // Buffer will grow as more files are found
-            .files = malloc(files_buf_size * sizeof(file_t))
-        },
         .filetypes = filetypes,
         .filetypes_count = filetypes_count,
-        .mx_indexing_shutdown = mx_indexing_shutdown
+        .max_signature_len = get_max_signature_len(filetypes, filetypes_count),
+        .mx_indexing_shutdown = mx_indexing_shutdown,
+        .throttle = options->throttle,
+        .one_file_system = options->one_file_system,
+        .sort_by_inode = options->sort_by_inode,
+        .network_dont_sync = options->network_dont_sync,
+        .root_device = root_stat.st_dev,
+        .exclusion_rules = options->exclusion_rules,
+        .excluded = { .excluded_entries = 0, .pruned_dirs = 0 },
+        .publish_snapshot = options->publish_snapshot,
+        .snapshot_arg = options->snapshot_arg,
+        .snapshot_interval = SNAPSHOT_INTERVAL
     };
+    if(clock_gettime(CLOCK_MONOTONIC, &indexing_data.last_snapshot_end)) ERR("clock_gettime");
+    if(pthread_mutex_init(&indexing_data.mx_snapshot, NULL)) ERR("pthread_mutex_init");
+    if(pthread_mutex_init(&indexing_data.mx_exclusions, NULL)) ERR("pthread_mutex_init");
+    char* building_path = get_building_index_path(options->index_path);
+    char* rejects_path = get_rejects_path(options->index_path);
+    index_builder_init(&indexing_data.builder, options->memory_budget, building_path);
+    device_scheduler_init(&indexing_data.scheduler, options->traversal_threads);
+    signature_cache_init(&indexing_data.signature_cache, options->previous_index, rejects_path);
+
+    // Paths of all files are built from the resolved root path
+    char* root_path = realpath(dir_path, NULL);
+    if(root_path == NULL) ERR("realpath");
+    indexing_data.root_path_len = strlen(root_path);
+    device_scheduler_push(&indexing_data.scheduler, root_stat.st_dev, root_path);
+    thread_pool_t pool;
+    thread_pool_init(&pool, options->traversal_threads);
+    thread_pool_run(&pool, pool.thread_count, traverse_directories, &indexing_data);
+    thread_pool_destroy(&pool);
+    device_scheduler_destroy(&indexing_data.scheduler);
+    pthread_mutex_destroy(&indexing_data.mx_snapshot);
+    pthread_mutex_destroy(&indexing_data.mx_exclusions);
+
+    *index = (index_t){ .files = NULL, .mapping = NULL, .files_count = 0, .generation = 0 };
+    bool is_finished = true;
+    // Merging runs of an interrupted bounded build would be wasted work
+    if(should_stop_indexing(mx_indexing_shutdown)) index_builder_abort(&indexing_data.builder);
+    else {
+        is_finished = try_to_finish_index_builder(&indexing_data.builder, index);
+        if(is_finished) {
+            compute_directory_rollups(index);
+            signature_cache_save(&indexing_data.signature_cache, rejects_path);
+        }
+    }
+    signature_cache_destroy(&indexing_data.signature_cache);
+    free(rejects_path);
+    free(building_path);
+    if(!is_finished) return false;
+
+    index->excluded = indexing_data.excluded;
+    index->creation_time = time(NULL);
+    if(index->creation_time == -1) ERR("time");
+    return true;
+}
 
-    size_t max_signature_len = get_max_signature_len(filetypes, filetypes_count);
+// Executed by every traversal thread until there are no directories left
+void traverse_directories(void* void_indexing_data, size_t thread_id) {
+    (void)thread_id;
+    partial_indexing_data_t* indexing_data = void_indexing_data;
+    if(indexing_data->throttle != NULL) lower_thread_priority();
+    char* read_buffer = malloc(DIR_READ_BUFFER_LEN);
+    if(read_buffer == NULL) ERR("malloc");
+
+    dev_t device;
+    bool is_network;
+    char* dir_path;
+    while((dir_path = device_scheduler_pop(&indexing_data->scheduler, &device, &is_network))) {
+        load_dir_to_index(dir_path, is_network, indexing_data, read_buffer);
+        device_scheduler_done(&indexing_data->scheduler, device);
+        free(dir_path);
+        publish_snapshot_if_due(indexing_data);
+        if(should_stop_indexing(indexing_data->mx_indexing_shutdown))
+            device_scheduler_stop(&indexing_data->scheduler);
+    }
 
-    load_dir_to_index(dir_path, &indexing_data, &files_buf_size, max_signature_len);
-    // Buffer is truncated to the area where files are kept
-    indexing_data.index.files =
-        realloc(indexing_data.index.files, indexing_data.index.files_count * sizeof(file_t));
-    if(indexing_data.index.files_count != 0 && indexing_data.index.files == NULL) ERR("realloc");
-    indexing_data.index.creation_time = time(NULL);
-    if(indexing_data.index.creation_time == -1) ERR("time");
-    return indexing_data.index;
+    free(read_buffer);
 }
 
-// Recursively adds next directory to the index being built
+// Snapshots are taken by one traversal thread at a time, the others keep indexing.
+// The interval is measured from the end of the previous snapshot and is at least
+// a few times its duration, so large indices are not snapshotted continuously.
+void publish_snapshot_if_due(partial_indexing_data_t* indexing_data) {
+    if(indexing_data->publish_snapshot == NULL) return;
+    if(pthread_mutex_trylock(&indexing_data->mx_snapshot)) return;
+    if(get_seconds_since(&indexing_data->last_snapshot_end) < indexing_data->snapshot_interval) {
+        pthread_mutex_unlock(&indexing_data->mx_snapshot);
+        return;
+    }
+
+    struct timespec start;
+    if(clock_gettime(CLOCK_MONOTONIC, &start)) ERR("clock_gettime");
+    time_t current_time = time(NULL);
+    if(current_time == -1) ERR("time");
+
+    indexing_progress_t progress;
+    progress.files_indexed = index_builder_count(&indexing_data->builder);
+    device_scheduler_get_progress(
+        &indexing_data->scheduler, &progress.dirs_indexed, &progress.dirs_pending);
+    // Copying the records of bounded builds would exceed the memory budget
+    if(indexing_data->builder.memory_budget != UNLIMITED_BUILD_MEMORY)
+        indexing_data->publish_snapshot(NULL, &progress, indexing_data->snapshot_arg);
+    else {
+        index_t snapshot = index_builder_snapshot(&indexing_data->builder);
+        compute_directory_rollups(&snapshot);
+        snapshot.creation_time = current_time;
+        indexing_data->publish_snapshot(&snapshot, &progress, indexing_data->snapshot_arg);
+    }
+
+    double duration = get_seconds_since(&start);
+    indexing_data->snapshot_interval = SNAPSHOT_COST_FACTOR * duration > SNAPSHOT_INTERVAL ?
+        SNAPSHOT_COST_FACTOR * duration : SNAPSHOT_INTERVAL;
+    if(clock_gettime(CLOCK_MONOTONIC, &indexing_data->last_snapshot_end)) ERR("clock_gettime");
+    pthread_mutex_unlock(&indexing_data->mx_snapshot);
+}
+
+// Adds files of the directory to the index, its subdirectories are scheduled separately.
+// `dir_path` has to be an absolute path without symbolic links.
 void load_dir_to_index(
     char* dir_path,
+    bool is_network,
     partial_indexing_data_t* indexing_data,
-    size_t* files_buf_size,
-    size_t max_signature_len
+    char* read_buffer
 ) {
-    DIR* dir = opendir(dir_path);
-    if(dir == NULL) ERR("opendir");
+    throttle_operation(indexing_data->throttle, 0);
+    dir_reader_t reader;
+    dir_reader_open(&reader, dir_path, read_buffer, DIR_READ_BUFFER_LEN);
+    open_dir_t dir = {
+        .path = dir_path,
+        .desc = reader.dir_desc,
+        .stat_flags = AT_SYMLINK_NOFOLLOW
+    };
+    // Attributes cached by the client are used instead of revalidating them with the server
+    if(is_network && indexing_data->network_dont_sync) dir.stat_flags |= AT_STATX_DONT_SYNC;
+
+    dir_batch_t batch = {
+        .files = malloc(DIR_BATCH_LEN * sizeof(file_t)),
+        .files_count = 0,
+        .excluded = { .excluded_entries = 0, .pruned_dirs = 0 }
+    };
+    if(batch.files == NULL) ERR("malloc");
+    // Shutdown is checked once per batch of entries
+    while(
+        !should_stop_indexing(indexing_data->mx_indexing_shutdown) &&
+        dir_reader_read_entries(&reader, indexing_data->sort_by_inode)
+    ) {
+        for(size_t i = 0; i < reader.entries_count; ++i)
+            add_dir_entry(&dir, indexing_data, &reader.entries[i], &batch);
+    }
 
-    while(try_to_add_next_dir_entry(
-            dir_path, indexing_data, dir, files_buf_size, max_signature_len));
+    index_builder_add(&indexing_data->builder, batch.files, batch.files_count);
+    add_exclusion_counts(indexing_data, &batch.excluded);
+    free(batch.files);
+    dir_reader_close(&reader);
+}
 
-    if(closedir(dir)) ERR("closedir");
+void add_exclusion_counts(partial_indexing_data_t* indexing_data, exclusion_counts_t* counts) {
+    if(counts->excluded_entries == 0 && counts->pruned_dirs == 0) return;
+    pthread_mutex_lock(&indexing_data->mx_exclusions);
+    indexing_data->excluded.excluded_entries += counts->excluded_entries;
+    indexing_data->excluded.pruned_dirs += counts->pruned_dirs;
+    pthread_mutex_unlock(&indexing_data->mx_exclusions);
 }
 
 size_t get_max_signature_len(filetype_t* filetypes, size_t filetypes_count) {
@@ -125,36 +323,64 @@ size_t get_max_signature_len(filetype_t* filetypes, size_t filetypes_count) {
     return max_len;
 }
 
-// Tries to add next directory to the index, returns true if succeds, false if there isn't
-// anything left to do
-bool try_to_add_next_dir_entry(
-    char* dir_path,
+// Adds the directory entry to the batch if it matches, subdirectories are scheduled for indexing
+void add_dir_entry(
+    open_dir_t* dir,
     partial_indexing_data_t* indexing_data,
-    DIR* dir,
-    size_t* files_buf_size,
-    size_t max_signature_len
+    dir_entry_t* entry,
+    dir_batch_t* batch
 ) {
-    if(should_stop_indexing(indexing_data->mx_indexing_shutdown)) return false;
-    errno = 0;
-    struct dirent* dir_entry = readdir(dir);
-    if(errno) ERR("readdir");
-    if(dir_entry == NULL) return false;
-
-    if(strcmp("..", dir_entry->d_name) == 0 || strcmp(".", dir_entry->d_name) == 0) return true;
-    char* file_path = get_file_path(dir_path, dir_entry->d_name);
-    if(indexing_data->index.files_count == *files_buf_size)
-        reallocate_files_buffer(&indexing_data->index, files_buf_size);
-
-    file_t* current_file = &indexing_data->index.files[indexing_data->index.files_count];
-    bool has_been_added =
-        add_next_file_if_matches(indexing_data, file_path, dir_entry->d_name, max_signature_len);
-    if(has_been_added && current_file->type == FILETYPE_DIRECTORY)
-        load_dir_to_index(file_path, indexing_data, files_buf_size, max_signature_len);
-
-    free(file_path);
+    // Only directories and regular files can be indexed, others are rejected without stat
+    if(entry->type != DT_DIR && entry->type != DT_REG && entry->type != DT_UNKNOWN) return;
+    char* file_path = get_file_path(dir->path, entry->name);
+    // Excluded entries cost no system calls
+    if(is_entry_excluded(indexing_data->exclusion_rules, entry->name, file_path)) {
+        batch->excluded.excluded_entries += 1;
+        free(file_path);
+        return;
+    }
+
+    throttle_operation(indexing_data->throttle, 0);
+    file_t* current_file = &batch->files[batch->files_count];
+    if(!add_next_file_if_matches(indexing_data, current_file, dir, file_path, entry->name)) {
+        free(file_path);
+        return;
+    }
+
+    if(
+        current_file->type == FILETYPE_DIRECTORY &&
+        should_descend(indexing_data, current_file, batch)
+    )
+        device_scheduler_push(&indexing_data->scheduler, current_file->device, file_path);
+    else free(file_path);
+
+    if(++batch->files_count == DIR_BATCH_LEN) {
+        index_builder_add(&indexing_data->builder, batch->files, batch->files_count);
+        batch->files_count = 0;
+    }
+}
+
+// Mount points on other devices are indexed, but not their contents in one file system mode.
+// The same applies to directories at the maximum depth.
+bool should_descend(partial_indexing_data_t* indexing_data, file_t* dir, dir_batch_t* batch) {
+    if(indexing_data->one_file_system && dir->device != indexing_data->root_device) return false;
+    size_t depth = get_dir_depth(indexing_data, dir->path);
+    if(is_depth_excluded(indexing_data->exclusion_rules, depth + 1)) {
+        batch->excluded.pruned_dirs += 1;
+        return false;
+    }
+
     return true;
 }
 
+// Children of the indexed directory are at depth 1
+size_t get_dir_depth(partial_indexing_data_t* indexing_data, char* path) {
+    size_t depth = 0;
+    for(char* c = path + indexing_data->root_path_len; *c != '\0'; ++c)
+        if(*c == '/') depth += 1;
+    return depth;
+}
+
 bool should_stop_indexing(pthread_mutex_t* mx_indexing_shutdown) {
     if(mx_indexing_shutdown != NULL && pthread_mutex_trylock(mx_indexing_shutdown) == 0) {
         pthread_mutex_unlock(mx_indexing_shutdown);
@@ -176,59 +402,76 @@ char* get_file_path(char* dir_path, char* filename) {
     return file_path;
 }
 
-void reallocate_files_buffer(index_t* index, size_t* files_buf_size) {
-    *files_buf_size *= 2;
-    index->files = realloc(index->files, *files_buf_size * sizeof(file_t));
-    if(index->files == NULL) ERR("realloc");
-}
-
 // Adds the next file to the index if its type is allowed
 // Returns true if the file has been added, false otherwise
 bool add_next_file_if_matches(
     partial_indexing_data_t* indexing_data,
+    file_t* file,
+    open_dir_t* dir,
     char* path,
-    char* name,
-    size_t max_signature_len
+    char* name
 ) {
-    file_t* file = &indexing_data->index.files[indexing_data->index.files_count];
-    if(!try_to_fill_in_stat_data(
-        file,
-        path,
-        indexing_data->filetypes,
-        indexing_data->filetypes_count,
-        max_signature_len
-    ))
-        return false;
+    if(!try_to_fill_in_stat_data(file, dir, name, path, indexing_data)) return false;
     fill_in_name_data(file, name);
     fill_in_path_data(file, path);
-    indexing_data->index.files_count += 1;
     return true;
 }
 
-// Tries to fill in information about the file based on lstat.
+// Tries to fill in information about the file `name` in the directory `dir`
+// based on statx, without following symbolic links.
+// Only the attributes stored in the index are requested.
 // Returns true if succeds, false otherwise
 bool try_to_fill_in_stat_data(
     file_t* file,
+    open_dir_t* dir,
+    char* name,
     char* path,
-    filetype_t* filetypes,
-    size_t filetypes_count,
-    size_t max_signature_len
+    partial_indexing_data_t* indexing_data
 ) {
-    struct stat filestat;
-    if(lstat(path, &filestat)) ERR("lstat");
+    struct statx filestat;
+    if(statx(dir->desc, name, dir->stat_flags, INDEXED_STATX_MASK, &filestat)) {
+        // The file has been removed since its directory has been read
+        if(errno == ENOENT) return false;
+        ERR("statx");
+    }
 
-    if(S_ISDIR(filestat.st_mode)) file->type = FILETYPE_DIRECTORY;
-    else {
-        if(!S_ISREG(filestat.st_mode)) return false;
+    if(!S_ISDIR(filestat.stx_mode) && !S_ISREG(filestat.stx_mode)) return false;
+    file->owner = filestat.stx_uid;
+    file->size = filestat.stx_size;
+    file->device = makedev(filestat.stx_dev_major, filestat.stx_dev_minor);
+    file->inode = filestat.stx_ino;
+    file->mtime = filestat.stx_mtime.tv_sec;
+    file->ctime = filestat.stx_ctime.tv_sec;
+    file->hashes = (content_hashes_t){ .has_prefix_hash = false, .has_full_hash = false };
 
-        file->type = get_regular_filetype(path, filetypes, filetypes_count, max_signature_len);
-        if(file->type == FILETYPE_INVALID) return false;
-    }
+    if(S_ISDIR(filestat.stx_mode)) file->type = FILETYPE_DIRECTORY;
+    else file->type = get_cached_regular_filetype(file, path, indexing_data);
 
-    file->owner = filestat.st_uid;
-    file->size = filestat.st_size;
+    return file->type != FILETYPE_INVALID;
+}
 
-    return true;
+// Signatures are only read for files which are new or have changed since the previous indexing
+size_t get_cached_regular_filetype(
+    file_t* file,
+    char* path,
+    partial_indexing_data_t* indexing_data
+) {
+    size_t type;
+    if(signature_cache_lookup(&indexing_data->signature_cache, path, file, &type)) {
+        if(type == FILETYPE_INVALID)
+            signature_cache_add_reject(&indexing_data->signature_cache, file);
+        return type;
+    }
+
+    type = get_regular_filetype(
+        path,
+        indexing_data->filetypes,
+        indexing_data->filetypes_count,
+        indexing_data->max_signature_len,
+        indexing_data->throttle
+    );
+    if(type == FILETYPE_INVALID) signature_cache_add_reject(&indexing_data->signature_cache, file);
+    return type;
 }
 
 void fill_in_name_data(file_t* file, char* name) {
@@ -244,22 +487,24 @@ void fill_in_name_data(file_t* file, char* name) {
     else {
         strcpy(file->name, name);
     }
+
+    fold_case(file->name, file->folded_name, MAX_FOLDED_LEN(MAX_FILENAME_LEN));
 }
 
+// Paths of indexed directories are already resolved, so `path` is absolute
 void fill_in_path_data(file_t* file, char* path) {
-    char* absolute_path = realpath(path, NULL);
-    if(absolute_path == NULL) ERR("realpath");
-    if(strlen(absolute_path) > MAX_FILEPATH_LEN) {
+    if(strlen(path) > MAX_FILEPATH_LEN) {
         fprintf(
             stderr,
             "A file with absolute path longer than allowed (%lu) has been detected\n",
             MAX_FILEPATH_LEN
         );
-        absolute_path[MAX_FILEPATH_LEN] = '\0';
+        memcpy(file->path, path, MAX_FILEPATH_LEN);
+        file->path[MAX_FILEPATH_LEN] = '\0';
+    }
+    else {
+        strcpy(file->path, path);
     }
-
-    strcpy(file->path, absolute_path);
-    free(absolute_path);
 }
 
 // Returns the index of the file type in the `filetypes` array
@@ -267,11 +512,15 @@ size_t get_regular_filetype(
     char* path,
     filetype_t* filetypes,
     size_t filetypes_count,
-    size_t max_signature_len
+    size_t max_signature_len,
+    throttle_t* throttle
 ) {
     char* signature = malloc(max_signature_len);
     if(signature == NULL) ERR("malloc");
-    size_t signature_len = read_file_signature(path, signature, max_signature_len);
+    // Throttled indexing should not evict the page cache of other processes
+    size_t signature_len =
+        read_file_signature(path, signature, max_signature_len, throttle != NULL);
+    throttle_operation(throttle, signature_len);
 
     size_t filetype = FILETYPE_INVALID;
     for(size_t i = 1; i < filetypes_count; ++i) {
@@ -297,52 +546,112 @@ bool does_match_any_signature(filetype_t* filetype, char* signature, size_t sign
 
 void* async_update_index(void* void_args) {
     indexing_data_t* data = void_args;
-    index_t new_index = create_index(
+    // Throttling is decided at the start of indexing, limits can still be changed later on
+    indexing_options_t options = get_indexing_options(data);
+    throttle_t* throttle = options.throttle;
+    if(throttle != NULL) {
+        throttle_reset_stats(throttle);
+        lower_thread_priority();
+    }
+    struct timespec start;
+    if(clock_gettime(CLOCK_MONOTONIC, &start)) ERR("clock_gettime");
+
+    index_t new_index;
+    bool is_created = try_to_create_index(
         data->dir_path,
         data->filetypes,
         data->filetypes_count,
-        &data->mx_indexing_shutdown
+        &data->mx_indexing_shutdown,
+        &options,
+        &new_index
     );
+    // A failed rebuild leaves the previous index published
+    if(!is_created) {
+        fprintf(stderr, "Indexing has failed, the previous index is kept.\n");
+        pthread_mutex_unlock(&data->mx_indexing_process);
+        print_command_prompt();
+        return NULL;
+    }
     if(should_stop_indexing(&data->mx_indexing_shutdown)) {
         destroy_index(&new_index);
         pthread_mutex_unlock(&data->mx_indexing_process);
         return NULL;
     }
-    swap_indices(data->index_path, &data->index, &new_index, &data->mx_index);
+    double duration = get_seconds_since(&start);
+    // Files of a partial index have not been compared with the file system yet,
+    // so there are no changes to report and no churn to adapt the interval to
+    index_diff_t diff;
+    bool has_diff = !data->index.is_partial;
+    if(has_diff) diff = compute_index_diff(&data->index, &new_index);
+    swap_indices(data, &new_index, has_diff ? &diff : NULL);
+    if(has_diff)
+        rebuild_scheduler_report(
+            &data->rebuild_scheduler, diff.changed_count, data->index.files_count, duration);
+    else
+        rebuild_scheduler_report_first_build(
+            &data->rebuild_scheduler, data->index.files_count, duration);
     pthread_mutex_unlock(&data->mx_indexing_process);
-    printf("Indexing has been completed.\n");
+    print_indexing_completion(throttle);
+    print_exclusion_counts(options.exclusion_rules, &new_index.excluded);
     print_command_prompt();
     return NULL;
 }
 
-void swap_indices(char* index_path,
-    index_t* old_index,
-    index_t* new_index,
-    pthread_mutex_t* mx_index
-) {
-    save_index_to_file(index_path, new_index);
-    pthread_mutex_lock(mx_index);
-    destroy_index(old_index);
-    *old_index = *new_index;
-    pthread_mutex_unlock(mx_index);
+double get_seconds_since(struct timespec* start) {
+    struct timespec now;
+    if(clock_gettime(CLOCK_MONOTONIC, &now)) ERR("clock_gettime");
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
 }
 
-void* async_update_index_periodically(void* void_args) {
-    pthread_setcancelstate(PTHREAD_CANCEL_DEFERRED, NULL);
-    periodic_indexing_args_t* args = void_args;
-    time_t current_time, time_difference;
-    for(;;) {
-        current_time = time(NULL);
-        if(current_time == -1) ERR("time");
-        pthread_mutex_lock(&args->indexing_data->mx_index);
-        time_difference = current_time - args->indexing_data->index.creation_time;
-        pthread_mutex_unlock(&args->indexing_data->mx_index);
-        if(time_difference >= args->indexing_interval) {
-            try_to_start_async_indexing(args->indexing_data);
-            sleep(args->indexing_interval);
-        }
-        else sleep(args->indexing_interval - time_difference);
+void print_indexing_completion(throttle_t* throttle) {
+    if(throttle == NULL) {
+        printf("Indexing has been completed.\n");
+        return;
     }
+
+    double throttled_seconds;
+    size_t throttled_ops;
+    throttle_get_stats(throttle, &throttled_seconds, &throttled_ops);
+    printf(
+        "Indexing has been completed (throttled for %.1lf s over %lu operations).\n",
+        throttled_seconds,
+        throttled_ops
+    );
+}
+
+void print_exclusion_counts(exclusion_rules_t* rules, exclusion_counts_t* counts) {
+    if(!has_exclusion_rules(rules)) return;
+    printf(
+        "Exclusion rules skipped %lu entries and %lu directories at the maximum depth.\n",
+        counts->excluded_entries,
+        counts->pruned_dirs
+    );
+}
+
+// The diff, which can be NULL, is published together with the new index
+void swap_indices(indexing_data_t* data, index_t* new_index, index_diff_t* diff) {
+    pthread_mutex_lock(&data->mx_index);
+    carry_over_content_hashes(&data->index, new_index);
+    pthread_mutex_unlock(&data->mx_index);
+
+    save_new_index(data->index_path, new_index);
+    if(data->shared_index.role == SHARED_INDEX_PUBLISHER)
+        shared_index_publish(&data->shared_index, new_index);
+    pthread_mutex_lock(&data->mx_index);
+    new_index->generation = data->index.generation + 1;
+    if(diff != NULL) {
+        diff->generation = new_index->generation;
+        index_history_push(&data->index_history, diff);
+    }
+    destroy_index(&data->index);
+    data->index = *new_index;
+    pthread_mutex_unlock(&data->mx_index);
+}
+
+void* async_update_index_periodically(void* void_args) {
+    indexing_data_t* indexing_data = void_args;
+    while(rebuild_scheduler_wait(&indexing_data->rebuild_scheduler))
+        try_to_start_async_indexing(indexing_data);
     return NULL;
 }
 
@@ -368,8 +677,78 @@ bool try_to_start_async_indexing(indexing_data_t* indexing_data) {
     return false;
 }
 
+indexing_options_t get_indexing_options(indexing_data_t* indexing_data) {
+    return (indexing_options_t){
+        .throttle =
+            throttle_is_enabled(&indexing_data->throttle) ? &indexing_data->throttle : NULL,
+        .memory_budget = indexing_data->memory_budget,
+        .index_path = indexing_data->index_path,
+        .traversal_threads = indexing_data->traversal_threads,
+        .one_file_system = indexing_data->one_file_system,
+        .sort_by_inode = indexing_data->sort_by_inode,
+        .network_dont_sync = indexing_data->network_dont_sync,
+        .exclusion_rules = &indexing_data->exclusion_rules,
+        // A partial index is replaced by snapshots during indexing
+        .previous_index = indexing_data->index.is_partial ? NULL : &indexing_data->index,
+        .publish_snapshot = indexing_data->index.is_partial ? publish_partial_index : NULL,
+        .snapshot_arg = indexing_data
+    };
+}
+
+// Replaces the partial index served during the first indexing
+void publish_partial_index(index_t* snapshot, indexing_progress_t* progress, void* arg) {
+    indexing_data_t* data = arg;
+    pthread_mutex_lock(&data->mx_index);
+    if(snapshot != NULL) {
+        snapshot->generation = data->index.generation + 1;
+        destroy_index(&data->index);
+        data->index = *snapshot;
+        data->index.is_partial = true;
+    }
+    data->index.progress = *progress;
+    pthread_mutex_unlock(&data->mx_index);
+}
+
+void update_shared_index_client(indexing_data_t* indexing_data) {
+    index_t index;
+    if(!try_to_map_latest_generation(&indexing_data->shared_index, &index)) return;
+    pthread_mutex_lock(&indexing_data->mx_index);
+    // Numbers of shared generations start again when the publisher is replaced
+    index.generation = indexing_data->index.generation + 1;
+    destroy_index(&indexing_data->index);
+    indexing_data->index = index;
+    pthread_mutex_unlock(&indexing_data->mx_index);
+}
+
+// Index served until the first indexing publishes a snapshot
+index_t create_partial_index() {
+    index_t index = {
+        .files = NULL,
+        .mapping = NULL,
+        .files_count = 0,
+        .generation = 0,
+        .is_partial = true,
+        .progress = { .files_indexed = 0, .dirs_indexed = 0, .dirs_pending = 1 },
+        .excluded = { .excluded_entries = 0, .pruned_dirs = 0 },
+        .root_rollup = { .total_size = 0, .type_counts = { 0 } }
+    };
+    index.creation_time = time(NULL);
+    if(index.creation_time == -1) ERR("time");
+    return index;
+}
+
+// Bounded builds leave the new index in a separate file until it is published
+void save_new_index(char* index_path, index_t* index) {
+    if(index->is_file_mapped) publish_built_index(index_path, index);
+    else save_index_to_file(index_path, index);
+}
+
 void destroy_index(index_t* index) {
     index->files_count = 0;
-    free(index->files);
+    if(index->mapping != NULL) {
+        if(munmap(index->mapping, index->mapping_size)) ERR("munmap");
+        index->mapping = NULL;
+    }
+    else free(index->files);
     index->files = NULL;
 }
@@ -3,6 +3,19 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "throttle.h"
+#include "query_cache.h"
+#include "output.h"
+#include "time_index.h"
+#include "rebuild_scheduler.h"
+#include "index_diff.h"
+#include "exclusion.h"
+#include "shared_index.h"
+#include "thread_pool.h"
+#include "case_fold.h"
 
 typedef struct magic_number {
     char* signature;
@@ -33,22 +46,75 @@ typedef struct filetype {
 
 #define FILETYPE_DIRECTORY 0LU
 #define FILETYPE_INVALID -1LU
+#define MAX_FILETYPES 8LU
 
 #define MAX_FILENAME_LEN 256LU
 #define MAX_FILEPATH_LEN 1024LU
 
+// Content hashes computed by the `duplicates` command.
+// They are valid as long as `device`, `inode`, `mtime` and `size` of the file stay the same.
+typedef struct content_hashes {
+    uint64_t prefix_hash;
+    uint64_t full_hash;
+    bool has_prefix_hash;
+    bool has_full_hash;
+} content_hashes_t;
+
+// Totals of all files below a directory, computed once the whole index has been built
+typedef struct directory_rollup {
+    // Sum of sizes of regular files
+    off_t total_size;
+    // Number of files of every type, the count of FILETYPE_DIRECTORY is the number of subdirectories
+    size_t type_counts[MAX_FILETYPES];
+} directory_rollup_t;
+
 typedef struct file {
     char name[MAX_FILENAME_LEN + 1];
+    // Case folded name, compared by case-insensitive queries
+    char folded_name[MAX_FOLDED_LEN(MAX_FILENAME_LEN) + 1];
     char path[MAX_FILEPATH_LEN + 1];
     off_t size;
     uid_t owner;
     size_t type;
+    dev_t device;
+    ino_t inode;
+    time_t mtime;
+    // Time of the last change of the file status
+    time_t ctime;
+    content_hashes_t hashes;
+    // Zero for files other than directories
+    directory_rollup_t rollup;
+    // Index of the first record after the contents of the directory, which directly follow it.
+    // Files other than directories have no contents.
+    size_t subtree_end;
 } file_t;
 
+// State of the indexing a partial index has been taken from
+typedef struct indexing_progress {
+    size_t files_indexed;
+    size_t dirs_indexed;
+    size_t dirs_pending;
+} indexing_progress_t;
+
 typedef struct index {
     file_t* files;
+    // Indices served from disk or from a published shared generation point `files`
+    // into its mapping, otherwise NULL
+    void* mapping;
+    size_t mapping_size;
+    // Set if `mapping` is of the index file, so saving the index only flushes it
+    bool is_file_mapped;
     time_t creation_time;
     size_t files_count;
+    // Incremented every time a new index is published
+    uint64_t generation;
+    // Set for indices served while the first indexing is in progress
+    bool is_partial;
+    indexing_progress_t progress;
+    // Entries skipped by exclusion rules while the index was built, not persisted
+    exclusion_counts_t excluded;
+    // Totals of the indexed root directory, which has no record
+    directory_rollup_t root_rollup;
 } index_t;
 
 // Structure containing all data which could be necessary during index operations
@@ -63,24 +129,78 @@ typedef struct indexing_data {
     pthread_mutex_t mx_indexing_shutdown;
     pthread_t indexing_thread_id;
     bool async_indexing_started;
+    rebuild_scheduler_t rebuild_scheduler;
+    // Changes made by the last rebuilds, guarded by `mx_index`
+    index_history_t index_history;
+    throttle_t throttle;
+    // Bytes of memory indexing can use, bounded builds are served from the mapped index file
+    size_t memory_budget;
+    size_t traversal_threads;
+    // Mount points are indexed, but not descended into
+    bool one_file_system;
+    bool sort_by_inode;
+    bool network_dont_sync;
+    exclusion_rules_t exclusion_rules;
+    // Every published index is copied to the shared index of a publisher,
+    // clients serve generations mapped from it instead of indexing
+    shared_index_t shared_index;
+    // Only accessed by the thread executing commands
+    query_cache_t query_cache;
+    time_index_t time_index;
+    // Scans of queries and hashing of duplicates are split between its threads
+    thread_pool_t query_pool;
+    output_t output;
 } indexing_data_t;
 
-index_t create_index(
+// Receives progress of the indexing and, if `snapshot` is not NULL, a partial index
+// ordered by path, which it takes ownership of
+typedef void (*snapshot_publisher_t) (index_t* snapshot, indexing_progress_t* progress, void* arg);
+
+// Settings of a single indexing process
+typedef struct indexing_options {
+    // NULL means that indexing is not rate-limited
+    throttle_t* throttle;
+    // If it is not 0, the index is built next to `index_path` and mapped,
+    // it has to be saved with `save_new_index`
+    size_t memory_budget;
+    char* index_path;
+    // Directories are indexed in parallel, with a separate concurrency limit for every device
+    size_t traversal_threads;
+    bool one_file_system;
+    // Directory entries are stat'ed in the order of their inodes, which improves disk locality
+    bool sort_by_inode;
+    // Files on network file systems are stat'ed with AT_STATX_DONT_SYNC
+    bool network_dont_sync;
+    // Excluded entries are skipped before they are stat'ed, excluded directories are not opened
+    exclusion_rules_t* exclusion_rules;
+    // Types of unchanged files are taken from it instead of reading their signatures again.
+    // It can be NULL, otherwise it must not be replaced until indexing completes.
+    index_t* previous_index;
+    // Called periodically during indexing, it can be NULL.
+    // Snapshots are only taken by indexing without a memory budget.
+    snapshot_publisher_t publish_snapshot;
+    void* snapshot_arg;
+} indexing_options_t;
+
+// Returns false if the built index cannot be used, an interrupted indexing returns an empty index
+bool try_to_create_index(
     char *dir_path,
     filetype_t* filetypes,
     size_t filetypes_count,
-    pthread_mutex_t* mx_indexing_shutdown
+    pthread_mutex_t* mx_indexing_shutdown,
+    indexing_options_t* options,
+    index_t* index
 );
-
-// `async_update_index_periodically` function argument
-typedef struct periodic_indexing_args {
-    int indexing_interval;
-    indexing_data_t* indexing_data;
-} periodic_indexing_args_t;
+indexing_options_t get_indexing_options(indexing_data_t* indexing_data);
+index_t create_partial_index();
+void save_new_index(char* index_path, index_t* index);
 
 void* async_update_index(void* void_args);
+// Rebuilds the index whenever the rebuild scheduler decides to, until it is stopped
 void* async_update_index_periodically(void* void_args);
 bool try_to_start_async_indexing(indexing_data_t* indexing_data);
+// Switches a client to the latest generation of its shared index, if there is a newer one
+void update_shared_index_client(indexing_data_t* indexing_data);
 void destroy_index(index_t* index);
 
 #endif
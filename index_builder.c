@@ -0,0 +1,341 @@
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "file_io.h"
+
+#include "index_builder.h"
+
+#define STARTING_RECORDS_CAPACITY 16LU
+// qsort of large elements may sort an array of pointers to them first
+#define SORTING_OVERHEAD_PER_RECORD (2 * sizeof(void*))
+
+// Reads records of a run in chunks of `capacity` records
+typedef struct run_reader {
+    int file_desc;
+    size_t records_left;
+    file_t* buffer;
+    size_t buffered_count;
+    size_t position;
+    size_t capacity;
+} run_reader_t;
+
+typedef struct record_writer {
+    int file_desc;
+    file_t* buffer;
+    size_t buffered_count;
+    size_t capacity;
+} record_writer_t;
+
+void grow_records_buffer(index_builder_t* builder);
+void spill_run(index_builder_t* builder);
+index_t finish_unbounded_build(index_builder_t* builder);
+bool try_to_finish_bounded_build(index_builder_t* builder, index_t* index);
+size_t get_merge_buffer_records(index_builder_t* builder);
+void merge_first_runs(index_builder_t* builder, size_t buffer_records);
+size_t count_run_records(index_run_t* runs, size_t run_count);
+void merge_runs(index_run_t* runs, size_t run_count, int output_desc, size_t buffer_records);
+void init_run_reader(run_reader_t* reader, index_run_t* run, size_t capacity);
+bool try_to_refill_run_reader(run_reader_t* reader);
+void sift_down_readers(run_reader_t** heap, size_t position, size_t count);
+bool is_reader_before(run_reader_t* a, run_reader_t* b);
+void init_record_writer(record_writer_t* writer, int file_desc, size_t capacity);
+void write_record(record_writer_t* writer, file_t* record);
+void flush_record_writer(record_writer_t* writer);
+int compare_records(const void* a, const void* b);
+int get_path_char_order(char c);
+void close_runs(index_builder_t* builder);
+
+void index_builder_init(index_builder_t* builder, size_t memory_budget, char* output_path) {
+    if(pthread_mutex_init(&builder->mx_builder, NULL)) ERR("pthread_mutex_init");
+    builder->memory_budget = memory_budget;
+    builder->output_path = output_path;
+    builder->records_count = 0;
+    builder->runs = NULL;
+    builder->run_count = 0;
+    if(memory_budget == UNLIMITED_BUILD_MEMORY)
+        builder->capacity = STARTING_RECORDS_CAPACITY;
+    else {
+        builder->capacity = memory_budget / (sizeof(file_t) + SORTING_OVERHEAD_PER_RECORD);
+        if(builder->capacity == 0) builder->capacity = 1;
+    }
+
+    builder->records = malloc(builder->capacity * sizeof(file_t));
+    if(builder->records == NULL) ERR("malloc");
+}
+
+void index_builder_add(index_builder_t* builder, file_t* records, size_t records_count) {
+    pthread_mutex_lock(&builder->mx_builder);
+    for(size_t i = 0; i < records_count; ++i) {
+        if(builder->records_count == builder->capacity) {
+            if(builder->memory_budget == UNLIMITED_BUILD_MEMORY) grow_records_buffer(builder);
+            else spill_run(builder);
+        }
+
+        builder->records[builder->records_count++] = records[i];
+    }
+    pthread_mutex_unlock(&builder->mx_builder);
+}
+
+size_t index_builder_count(index_builder_t* builder) {
+    pthread_mutex_lock(&builder->mx_builder);
+    size_t count = builder->records_count + count_run_records(builder->runs, builder->run_count);
+    pthread_mutex_unlock(&builder->mx_builder);
+    return count;
+}
+
+// Records are only copied under the lock, traversal threads can add more while they are sorted
+index_t index_builder_snapshot(index_builder_t* builder) {
+    pthread_mutex_lock(&builder->mx_builder);
+    index_t snapshot = {
+        .files = malloc(builder->records_count * sizeof(file_t)),
+        .mapping = NULL,
+        .mapping_size = 0,
+        .files_count = builder->records_count,
+        .generation = 0
+    };
+    if(snapshot.files_count != 0 && snapshot.files == NULL) ERR("malloc");
+    memcpy(snapshot.files, builder->records, builder->records_count * sizeof(file_t));
+    pthread_mutex_unlock(&builder->mx_builder);
+
+    qsort(snapshot.files, snapshot.files_count, sizeof(file_t), compare_records);
+    return snapshot;
+}
+
+void grow_records_buffer(index_builder_t* builder) {
+    builder->capacity *= 2;
+    builder->records = realloc(builder->records, builder->capacity * sizeof(file_t));
+    if(builder->records == NULL) ERR("realloc");
+}
+
+// Sorts the buffered records and moves them to a new run
+void spill_run(index_builder_t* builder) {
+    if(builder->records_count == 0) return;
+    qsort(builder->records, builder->records_count, sizeof(file_t), compare_records);
+
+    int file_desc = open_temporary_file(builder->output_path);
+    size_t run_size = builder->records_count * sizeof(file_t);
+    if(bulk_write(file_desc, (char*)builder->records, run_size) != (ssize_t)run_size)
+        ERR("write");
+
+    builder->runs = realloc(builder->runs, (builder->run_count + 1) * sizeof(index_run_t));
+    if(builder->runs == NULL) ERR("realloc");
+    builder->runs[builder->run_count++] = (index_run_t){
+        .file_desc = file_desc,
+        .records_count = builder->records_count
+    };
+    builder->records_count = 0;
+}
+
+bool try_to_finish_index_builder(index_builder_t* builder, index_t* index) {
+    pthread_mutex_destroy(&builder->mx_builder);
+    if(builder->memory_budget == UNLIMITED_BUILD_MEMORY) {
+        *index = finish_unbounded_build(builder);
+        return true;
+    }
+    return try_to_finish_bounded_build(builder, index);
+}
+
+index_t finish_unbounded_build(index_builder_t* builder) {
+    // Records arrive in the order in which traversal threads happen to finish
+    qsort(builder->records, builder->records_count, sizeof(file_t), compare_records);
+    // Buffer is truncated to the area where files are kept
+    index_t index = {
+        .files = realloc(builder->records, builder->records_count * sizeof(file_t)),
+        .mapping = NULL,
+        .mapping_size = 0,
+        .files_count = builder->records_count,
+        .generation = 0
+    };
+    if(index.files_count != 0 && index.files == NULL) ERR("realloc");
+    builder->records = NULL;
+    return index;
+}
+
+// The merged index is loaded back like any other index file, it is removed if that fails
+bool try_to_finish_bounded_build(index_builder_t* builder, index_t* index) {
+    spill_run(builder);
+    // The merge gets the whole budget
+    free(builder->records);
+    builder->records = NULL;
+
+    size_t buffer_records = get_merge_buffer_records(builder);
+    while(builder->run_count > MAX_MERGE_FAN_IN) merge_first_runs(builder, buffer_records);
+
+    int output_desc = open(builder->output_path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if(output_desc < 0) ERR("open");
+    write_index_header(output_desc, count_run_records(builder->runs, builder->run_count));
+    merge_runs(builder->runs, builder->run_count, output_desc, buffer_records);
+    if(close(output_desc)) ERR("close");
+    close_runs(builder);
+
+    index_t* loaded_index = index;
+    load_index_from_file(builder->output_path, &loaded_index, true);
+    if(loaded_index != NULL) return true;
+
+    fprintf(stderr, "Index merged into %s cannot be loaded!\n", builder->output_path);
+    if(unlink(builder->output_path) && errno != ENOENT) ERR("unlink");
+    return false;
+}
+
+// Every run being merged and the output get a buffer of the same size
+size_t get_merge_buffer_records(index_builder_t* builder) {
+    size_t buffer_records = builder->memory_budget / ((MAX_MERGE_FAN_IN + 1) * sizeof(file_t));
+    return buffer_records != 0 ? buffer_records : 1;
+}
+
+// Replaces MAX_MERGE_FAN_IN first runs with a single run
+void merge_first_runs(index_builder_t* builder, size_t buffer_records) {
+    index_run_t merged_run = {
+        .file_desc = open_temporary_file(builder->output_path),
+        .records_count = count_run_records(builder->runs, MAX_MERGE_FAN_IN)
+    };
+    merge_runs(builder->runs, MAX_MERGE_FAN_IN, merged_run.file_desc, buffer_records);
+    for(size_t i = 0; i < MAX_MERGE_FAN_IN; ++i)
+        if(close(builder->runs[i].file_desc)) ERR("close");
+
+    builder->run_count -= MAX_MERGE_FAN_IN;
+    memmove(
+        builder->runs,
+        builder->runs + MAX_MERGE_FAN_IN,
+        builder->run_count * sizeof(index_run_t)
+    );
+    builder->runs[builder->run_count++] = merged_run;
+}
+
+size_t count_run_records(index_run_t* runs, size_t run_count) {
+    size_t records_count = 0;
+    for(size_t i = 0; i < run_count; ++i) records_count += runs[i].records_count;
+    return records_count;
+}
+
+// K-way merge of sorted runs, the reader with the first record is kept at the root of a heap
+void merge_runs(index_run_t* runs, size_t run_count, int output_desc, size_t buffer_records) {
+    run_reader_t* readers = malloc(run_count * sizeof(run_reader_t));
+    run_reader_t** heap = malloc(run_count * sizeof(run_reader_t*));
+    if(run_count != 0 && (readers == NULL || heap == NULL)) ERR("malloc");
+
+    size_t heap_count = 0;
+    for(size_t i = 0; i < run_count; ++i) {
+        init_run_reader(&readers[i], &runs[i], buffer_records);
+        if(try_to_refill_run_reader(&readers[i])) heap[heap_count++] = &readers[i];
+    }
+
+    for(size_t i = heap_count / 2; i-- > 0;) sift_down_readers(heap, i, heap_count);
+
+    record_writer_t writer;
+    init_record_writer(&writer, output_desc, buffer_records);
+    while(heap_count > 0) {
+        run_reader_t* reader = heap[0];
+        write_record(&writer, &reader->buffer[reader->position++]);
+        if(!try_to_refill_run_reader(reader)) heap[0] = heap[--heap_count];
+        sift_down_readers(heap, 0, heap_count);
+    }
+
+    flush_record_writer(&writer);
+    free(writer.buffer);
+    for(size_t i = 0; i < run_count; ++i) free(readers[i].buffer);
+    free(heap);
+    free(readers);
+}
+
+void init_run_reader(run_reader_t* reader, index_run_t* run, size_t capacity) {
+    if(lseek(run->file_desc, 0, SEEK_SET) < 0) ERR("lseek");
+    reader->file_desc = run->file_desc;
+    reader->records_left = run->records_count;
+    reader->buffered_count = 0;
+    reader->position = 0;
+    reader->capacity = capacity;
+    reader->buffer = malloc(capacity * sizeof(file_t));
+    if(reader->buffer == NULL) ERR("malloc");
+}
+
+// Returns true if the reader has a record at `position`, false if the run is exhausted
+bool try_to_refill_run_reader(run_reader_t* reader) {
+    if(reader->position < reader->buffered_count) return true;
+    if(reader->records_left == 0) return false;
+
+    size_t count = reader->records_left < reader->capacity ? reader->records_left : reader->capacity;
+    size_t size = count * sizeof(file_t);
+    if(bulk_read(reader->file_desc, (char*)reader->buffer, size) != (ssize_t)size) ERR("read");
+    reader->buffered_count = count;
+    reader->position = 0;
+    reader->records_left -= count;
+    return true;
+}
+
+void sift_down_readers(run_reader_t** heap, size_t position, size_t count) {
+    for(;;) {
+        size_t first = position;
+        size_t left = 2 * position + 1;
+        size_t right = left + 1;
+        if(left < count && is_reader_before(heap[left], heap[first])) first = left;
+        if(right < count && is_reader_before(heap[right], heap[first])) first = right;
+        if(first == position) return;
+
+        run_reader_t* tmp = heap[position];
+        heap[position] = heap[first];
+        heap[first] = tmp;
+        position = first;
+    }
+}
+
+bool is_reader_before(run_reader_t* a, run_reader_t* b) {
+    return compare_records(&a->buffer[a->position], &b->buffer[b->position]) < 0;
+}
+
+void init_record_writer(record_writer_t* writer, int file_desc, size_t capacity) {
+    writer->file_desc = file_desc;
+    writer->buffered_count = 0;
+    writer->capacity = capacity;
+    writer->buffer = malloc(capacity * sizeof(file_t));
+    if(writer->buffer == NULL) ERR("malloc");
+}
+
+void write_record(record_writer_t* writer, file_t* record) {
+    if(writer->buffered_count == writer->capacity) flush_record_writer(writer);
+    writer->buffer[writer->buffered_count++] = *record;
+}
+
+void flush_record_writer(record_writer_t* writer) {
+    size_t size = writer->buffered_count * sizeof(file_t);
+    if(bulk_write(writer->file_desc, (char*)writer->buffer, size) != (ssize_t)size) ERR("write");
+    writer->buffered_count = 0;
+}
+
+int compare_records(const void* a, const void* b) {
+    return compare_index_paths(((const file_t*)a)->path, ((const file_t*)b)->path);
+}
+
+int compare_index_paths(const char* a, const char* b) {
+    for(; *a != '\0' && *a == *b; ++a, ++b);
+    return get_path_char_order(*a) - get_path_char_order(*b);
+}
+
+// `/` comes right after the end of the path, before any other character
+int get_path_char_order(char c) {
+    if(c == '\0') return 0;
+    if(c == '/') return 1;
+    return (unsigned char)c + 1;
+}
+
+void index_builder_abort(index_builder_t* builder) {
+    pthread_mutex_destroy(&builder->mx_builder);
+    free(builder->records);
+    builder->records = NULL;
+    builder->records_count = 0;
+    close_runs(builder);
+    if(builder->memory_budget != UNLIMITED_BUILD_MEMORY && unlink(builder->output_path)) {
+        if(errno != ENOENT) ERR("unlink");
+    }
+}
+
+void close_runs(index_builder_t* builder) {
+    for(size_t i = 0; i < builder->run_count; ++i)
+        if(close(builder->runs[i].file_desc)) ERR("close");
+    free(builder->runs);
+    builder->runs = NULL;
+    builder->run_count = 0;
+}
@@ -0,0 +1,53 @@
+#ifndef INDEX_BUILDER_H
+#define INDEX_BUILDER_H
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "index.h"
+
+#define UNLIMITED_BUILD_MEMORY 0LU
+// Number of runs merged at once, more runs are merged in several passes
+#define MAX_MERGE_FAN_IN 64LU
+
+// A sorted run of records spilled to an anonymous temporary file
+typedef struct index_run {
+    int file_desc;
+    size_t records_count;
+} index_run_t;
+
+// Collects records found during indexing.
+// Without a memory budget, records are kept in a growing array.
+// With a memory budget, records are sorted by path and spilled to temporary files
+// whenever the budget is exhausted, at the end the runs are merged into the index file.
+typedef struct index_builder {
+    // Records are added by many traversal threads
+    pthread_mutex_t mx_builder;
+    file_t* records;
+    size_t records_count;
+    size_t capacity;
+    size_t memory_budget;
+    // Index file written by bounded builds
+    char* output_path;
+    index_run_t* runs;
+    size_t run_count;
+} index_builder_t;
+
+// `output_path` is only used if `memory_budget` is not UNLIMITED_BUILD_MEMORY
+void index_builder_init(index_builder_t* builder, size_t memory_budget, char* output_path);
+void index_builder_add(index_builder_t* builder, file_t* records, size_t records_count);
+// Number of records added so far
+size_t index_builder_count(index_builder_t* builder);
+// Index of copies of the records added so far, sorted by `compare_index_paths`.
+// Only builds without a memory budget can be snapshotted.
+index_t index_builder_snapshot(index_builder_t* builder);
+// Records of the index are sorted by `compare_index_paths`.
+// Unbounded builds return an index kept in memory, bounded ones an index mapped from `output_path`.
+// Returns false and prints the reason if the index merged by a bounded build cannot be loaded.
+bool try_to_finish_index_builder(index_builder_t* builder, index_t* index);
+// Drops all records and removes the partially written index file
+void index_builder_abort(index_builder_t* builder);
+// Order of records in the index: every directory is directly followed by its contents
+int compare_index_paths(const char* a, const char* b);
+
+#endif
@@ -0,0 +1,125 @@
+#include <string.h>
+
+#include "error.h"
+#include "index.h"
+#include "index_builder.h"
+
+#include "index_diff.h"
+
+unsigned get_record_changes(file_t* old_file, file_t* new_file);
+void record_change(index_diff_t* diff, unsigned kinds, file_t* old_file, file_t* new_file);
+size_t store_changed_path(index_diff_t* diff, char* path);
+
+index_diff_t compute_index_diff(index_t* old_index, index_t* new_index) {
+    index_diff_t diff;
+    memset(&diff, 0, sizeof(index_diff_t));
+    diff.creation_time = new_index->creation_time;
+
+    size_t i = 0, j = 0;
+    while(i < old_index->files_count || j < new_index->files_count) {
+        file_t* old_file = i < old_index->files_count ? &old_index->files[i] : NULL;
+        file_t* new_file = j < new_index->files_count ? &new_index->files[j] : NULL;
+        int order =
+            old_file == NULL ? 1 :
+            new_file == NULL ? -1 :
+            compare_index_paths(old_file->path, new_file->path);
+
+        if(order < 0) record_change(&diff, CHANGE_REMOVED, old_file, NULL);
+        else if(order > 0) record_change(&diff, CHANGE_ADDED, NULL, new_file);
+        else record_change(&diff, get_record_changes(old_file, new_file), old_file, new_file);
+        if(order <= 0) i += 1;
+        if(order >= 0) j += 1;
+    }
+
+    return diff;
+}
+
+unsigned get_record_changes(file_t* old_file, file_t* new_file) {
+    unsigned kinds = 0;
+    if(old_file->size != new_file->size) kinds |= CHANGE_RESIZED;
+    if(old_file->type != new_file->type) kinds |= CHANGE_RETYPED;
+    if(old_file->owner != new_file->owner) kinds |= CHANGE_REOWNED;
+    if(kinds == 0 && (old_file->mtime != new_file->mtime || old_file->inode != new_file->inode))
+        kinds |= CHANGE_MODIFIED;
+    return kinds;
+}
+
+// Either of the files can be NULL if it does not exist in its index
+void record_change(index_diff_t* diff, unsigned kinds, file_t* old_file, file_t* new_file) {
+    if(kinds == 0) return;
+    diff->changed_count += 1;
+    for(size_t i = 0; i < CHANGE_KINDS_COUNT; ++i)
+        if(kinds & (1U << i)) diff->kind_counts[i] += 1;
+    if(diff->changes_count == MAX_RECORDED_CHANGES) return;
+
+    if(diff->changes_count == diff->changes_capacity) {
+        diff->changes_capacity = diff->changes_capacity == 0 ? 64 : 2 * diff->changes_capacity;
+        diff->changes = realloc(diff->changes, diff->changes_capacity * sizeof(file_change_t));
+        if(diff->changes == NULL) ERR("realloc");
+    }
+
+    file_t* file = new_file != NULL ? new_file : old_file;
+    diff->changes[diff->changes_count++] = (file_change_t){
+        .kinds = kinds,
+        .path_offset = store_changed_path(diff, file->path),
+        .old_size = old_file != NULL ? old_file->size : 0,
+        .new_size = new_file != NULL ? new_file->size : 0,
+        .old_type = old_file != NULL ? old_file->type : FILETYPE_INVALID,
+        .new_type = new_file != NULL ? new_file->type : FILETYPE_INVALID,
+        .old_owner = old_file != NULL ? old_file->owner : 0,
+        .new_owner = new_file != NULL ? new_file->owner : 0
+    };
+}
+
+// Paths are packed into a single buffer, so that a diff only takes as much memory as its paths
+size_t store_changed_path(index_diff_t* diff, char* path) {
+    size_t path_size = strlen(path) + 1;
+    if(diff->paths_len + path_size > diff->paths_capacity) {
+        diff->paths_capacity = 2 * diff->paths_capacity + MAX_FILEPATH_LEN + 1;
+        diff->paths = realloc(diff->paths, diff->paths_capacity);
+        if(diff->paths == NULL) ERR("realloc");
+    }
+
+    size_t offset = diff->paths_len;
+    memcpy(diff->paths + offset, path, path_size);
+    diff->paths_len += path_size;
+    return offset;
+}
+
+char* get_changed_file_path(index_diff_t* diff, file_change_t* change) {
+    return diff->paths + change->path_offset;
+}
+
+void destroy_index_diff(index_diff_t* diff) {
+    free(diff->changes);
+    free(diff->paths);
+    diff->changes = NULL;
+    diff->paths = NULL;
+}
+
+void index_history_init(index_history_t* history) {
+    history->first = 0;
+    history->diffs_count = 0;
+}
+
+void index_history_push(index_history_t* history, index_diff_t* diff) {
+    if(history->diffs_count == MAX_KEPT_DIFFS) {
+        destroy_index_diff(&history->diffs[history->first]);
+        history->first = (history->first + 1) % MAX_KEPT_DIFFS;
+        history->diffs_count -= 1;
+    }
+
+    history->diffs[(history->first + history->diffs_count) % MAX_KEPT_DIFFS] = *diff;
+    history->diffs_count += 1;
+}
+
+index_diff_t* index_history_get(index_history_t* history, size_t age) {
+    if(age >= history->diffs_count) return NULL;
+    return &history->diffs[(history->first + history->diffs_count - 1 - age) % MAX_KEPT_DIFFS];
+}
+
+void index_history_destroy(index_history_t* history) {
+    for(size_t i = 0; i < history->diffs_count; ++i)
+        destroy_index_diff(&history->diffs[(history->first + i) % MAX_KEPT_DIFFS]);
+    history->diffs_count = 0;
+}
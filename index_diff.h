@@ -0,0 +1,73 @@
+#ifndef INDEX_DIFF_H
+#define INDEX_DIFF_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+
+// Kinds of changes of a single file, a changed file can have several of them
+#define CHANGE_ADDED 0x01U
+#define CHANGE_REMOVED 0x02U
+#define CHANGE_RESIZED 0x04U
+#define CHANGE_RETYPED 0x08U
+#define CHANGE_REOWNED 0x10U
+// Modification time or inode changed, but none of the above
+#define CHANGE_MODIFIED 0x20U
+#define CHANGE_KINDS_COUNT 6LU
+
+// Changes of at most this many files are kept per diff, the rest is only counted
+#define MAX_RECORDED_CHANGES 4096LU
+// Number of diffs of consecutive index generations kept in the history
+#define MAX_KEPT_DIFFS 8LU
+
+struct index;
+
+typedef struct file_change {
+    unsigned kinds;
+    // Offset of the path in `paths` of the diff
+    size_t path_offset;
+    off_t old_size;
+    off_t new_size;
+    size_t old_type;
+    size_t new_type;
+    uid_t old_owner;
+    uid_t new_owner;
+} file_change_t;
+
+// Changes between two consecutive index generations
+typedef struct index_diff {
+    // Generation of the newer index
+    uint64_t generation;
+    time_t creation_time;
+    size_t changed_count;
+    // Number of files with every kind of change, in the order of the CHANGE_ bits
+    size_t kind_counts[CHANGE_KINDS_COUNT];
+    file_change_t* changes;
+    size_t changes_count;
+    size_t changes_capacity;
+    char* paths;
+    size_t paths_len;
+    size_t paths_capacity;
+} index_diff_t;
+
+// Ring of the last MAX_KEPT_DIFFS diffs
+typedef struct index_history {
+    index_diff_t diffs[MAX_KEPT_DIFFS];
+    size_t first;
+    size_t diffs_count;
+} index_history_t;
+
+// Both indices have to be ordered by `compare_index_paths`, they are compared in a single merge pass
+index_diff_t compute_index_diff(struct index* old_index, struct index* new_index);
+char* get_changed_file_path(index_diff_t* diff, file_change_t* change);
+void destroy_index_diff(index_diff_t* diff);
+
+void index_history_init(index_history_t* history);
+// Takes ownership of `diff`, the oldest diff is dropped if the history is full
+void index_history_push(index_history_t* history, index_diff_t* diff);
+// Returns the diff `age` generations back, 0 being the latest one, NULL if it is not kept
+index_diff_t* index_history_get(index_history_t* history, size_t age);
+void index_history_destroy(index_history_t* history);
+
+#endif
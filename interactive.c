@@ -1,10 +1,12 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "index.h"
 #include "error.h"
 #include "commands.h"
+#include "query.h"
 
 #include "interactive.h"
 
@@ -22,6 +24,13 @@ command_result_t* execute_command(
     indexing_data_t* data
 );
 command_t* get_matching_command(char* command, command_t* commands, size_t command_count);
+command_result_t* execute_interactive_command(
+    char* command_str,
+    command_t* commands,
+    size_t command_count,
+    indexing_data_t* data
+);
+void print_partial_index_notice(index_t* index);
 command_result_t* parse_and_call_command(char* command_str, command_t* command, indexing_data_t* data);
 
 void launch_interactive_console(indexing_data_t* data) {
@@ -42,13 +51,57 @@ void launch_interactive_console(indexing_data_t* data) {
         // when checking if the command is called with any arguments
         command_buf[strlen(command_buf) - 1] = '\0';
 
-        command_result_t* result = execute_command(command_buf, commands, command_count, data);
+        command_result_t* result =
+            execute_interactive_command(command_buf, commands, command_count, data);
         if(result != NULL) {
             if(result->should_close) break;
         }
     }
 }
 
+// Queries hold the index, so that new indices and snapshots are only swapped in between them.
+// Their results are paged after the index has been released, the pager can stay open indefinitely.
+command_result_t* execute_interactive_command(
+    char* command_str,
+    command_t* commands,
+    size_t command_count,
+    indexing_data_t* data
+) {
+    command_t* command = get_matching_command(command_str, commands, command_count);
+    if(data->shared_index.role == SHARED_INDEX_CLIENT) {
+        if(command != NULL && !command->allowed_in_client) {
+            fprintf(stderr, "Command `%s` is not available in client mode!\n", command->name);
+            return NULL;
+        }
+        // Every command is answered from the latest published generation
+        update_shared_index_client(data);
+    }
+
+    if(command == NULL || !command->allowed_in_batch)
+        return execute_command(command_str, commands, command_count, data);
+
+    pthread_mutex_lock(&data->mx_index);
+    if(data->index.is_partial) print_partial_index_notice(&data->index);
+    data->output.defers_paging = true;
+    command_result_t* result = execute_command(command_str, commands, command_count, data);
+    data->output.defers_paging = false;
+    pthread_mutex_unlock(&data->mx_index);
+    page_deferred_output(data);
+    return result;
+}
+
+void print_partial_index_notice(index_t* index) {
+    fprintf(
+        stderr,
+        "Partial results, indexing is in progress: %lu files in %lu directories indexed, "
+        "%lu directories queued (%lu files in the snapshot)\n",
+        index->progress.files_indexed,
+        index->progress.dirs_indexed,
+        index->progress.dirs_pending,
+        index->files_count
+    );
+}
+
 void invalid_command() {
     fprintf(stderr, "Invalid command!\n");
 }
@@ -2,8 +2,18 @@
 #define INTERACTIVE_H
 
 #include "index.h"
+#include "commands.h"
 
 void launch_interactive_console(indexing_data_t* data);
 void print_command_prompt();
+void invalid_command();
+// `command_str` has to end with two NUL characters
+command_result_t* execute_command(
+    char* command_str,
+    command_t* commands,
+    size_t command_count,
+    indexing_data_t* data
+);
+command_t* get_matching_command(char* command, command_t* commands, size_t command_count);
 
 #endif
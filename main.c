@@ -9,19 +9,24 @@
 #include "error.h"
 #include "file_io.h"
 #include "program_args.h"
+#include "batch.h"
+#include "index_builder.h"
 
 filetype_t get_available_filetypes();
 void initialize_mutexes(indexing_data_t* indexing_data);
 void cleanup(
     indexing_data_t* indexing_data,
     program_args_t* program_args,
-    pthread_t periodic_indexing_thread_id
+    pthread_t* periodic_indexing_thread_id
 );
-void initialize_index(indexing_data_t* indexing_data);
-pthread_t initialize_periodic_indexing_thread(
+void initialize_exclusion_rules(indexing_data_t* indexing_data, program_args_t* program_args);
+void initialize_index(indexing_data_t* indexing_data, program_args_t* program_args);
+void attach_to_shared_index(indexing_data_t* indexing_data, program_args_t* program_args);
+void finish_batch(indexing_data_t* indexing_data);
+bool try_to_start_periodic_indexing_thread(
     indexing_data_t* indexing_data,
     program_args_t* program_args,
-    periodic_indexing_args_t* periodic_indexing_args
+    pthread_t* thread_id
 );
 
 int main(int argc, char** argv) {
@@ -37,22 +42,55 @@ int main(int argc, char** argv) {
                 MAGIC_NUMBER("\x50\x4B\x05\x06"),
                 MAGIC_NUMBER("\x50\x4B\x07\x08"))
     };
+    // Directory rollups have a fixed number of counters
+    _Static_assert(sizeof(filetypes) / sizeof(filetype_t) <= MAX_FILETYPES, "Too many file types");
 
     indexing_data_t indexing_data = {
         .filetypes = filetypes,
         .filetypes_count = sizeof(filetypes) / sizeof(filetype_t),
         .dir_path = program_args.dir_path,
         .index_path = program_args.index_path,
+        .memory_budget = program_args.memory_budget,
+        .traversal_threads = program_args.traversal_threads,
+        .one_file_system = program_args.one_file_system,
+        .sort_by_inode = program_args.sort_by_inode,
+        .network_dont_sync = program_args.network_dont_sync,
         .async_indexing_started = false
     };
     initialize_mutexes(&indexing_data);
-    initialize_index(&indexing_data);
+    initialize_exclusion_rules(&indexing_data, &program_args);
+    throttle_init(
+        &indexing_data.throttle,
+        program_args.ops_per_second,
+        program_args.bytes_per_second
+    );
+    // Rebuilds can start while the index is initialized
+    index_history_init(&indexing_data.index_history);
+    shared_index_init(&indexing_data.shared_index);
+    if(program_args.client_index_name != NULL)
+        attach_to_shared_index(&indexing_data, &program_args);
+    else initialize_index(&indexing_data, &program_args);
+    query_cache_init(&indexing_data.query_cache);
+    time_index_init(&indexing_data.time_index);
+    thread_pool_init(&indexing_data.query_pool, 0);
+    init_interactive_output(&indexing_data.output);
 
-    periodic_indexing_args_t periodic_indexing_args;
-    pthread_t periodic_indexing_thread_id =
-        initialize_periodic_indexing_thread(&indexing_data, &program_args, &periodic_indexing_args);
-    launch_interactive_console(&indexing_data);
-    cleanup(&indexing_data, &program_args, periodic_indexing_thread_id);
+    pthread_t periodic_indexing_thread_id;
+    bool is_periodic_indexing_started = false;
+    if(program_args.batch_path != NULL) {
+        run_batch(&indexing_data, program_args.batch_path, program_args.output_format);
+        finish_batch(&indexing_data);
+    }
+    else {
+        is_periodic_indexing_started = try_to_start_periodic_indexing_thread(
+            &indexing_data, &program_args, &periodic_indexing_thread_id);
+        launch_interactive_console(&indexing_data);
+    }
+    cleanup(
+        &indexing_data,
+        &program_args,
+        is_periodic_indexing_started ? &periodic_indexing_thread_id : NULL
+    );
 
     return EXIT_SUCCESS;
 }
@@ -67,56 +105,121 @@ void initialize_mutexes(indexing_data_t* indexing_data) {
     pthread_mutex_lock(&indexing_data->mx_indexing_shutdown);
 }
 
-void initialize_index(indexing_data_t* indexing_data) {
+// Rules are compiled once, invalid rules are reported before anything is indexed
+void initialize_exclusion_rules(indexing_data_t* indexing_data, program_args_t* program_args) {
+    if(program_args->exclusion_rules_path == NULL)
+        init_exclusion_rules(&indexing_data->exclusion_rules);
+    else if(!try_to_load_exclusion_rules(
+        program_args->exclusion_rules_path, &indexing_data->exclusion_rules)
+    )
+        exit(EXIT_FAILURE);
+}
+
+// Without an index file, the first index is built in the background in interactive mode,
+// while commands are answered from its partial snapshots.
+// Batch queries are answered from a complete index, so it is built before they are executed.
+void initialize_index(indexing_data_t* indexing_data, program_args_t* program_args) {
+    if(program_args->shared_index_name != NULL)
+        shared_index_create(
+            &indexing_data->shared_index, program_args->shared_index_name, indexing_data->dir_path);
     index_t* index = &indexing_data->index;
-    load_index_from_file(indexing_data->index_path, &index);
-    if(index == NULL) {
-        indexing_data->index = create_index(
+    bool should_map = indexing_data->memory_budget != UNLIMITED_BUILD_MEMORY;
+    load_index_from_file(indexing_data->index_path, &index, should_map);
+    if(index == NULL && program_args->batch_path == NULL)
+        indexing_data->index = create_partial_index();
+    else if(index == NULL) {
+        indexing_options_t options = get_indexing_options(indexing_data);
+        options.previous_index = NULL;
+        options.publish_snapshot = NULL;
+        bool is_created = try_to_create_index(
             indexing_data->dir_path,
             indexing_data->filetypes,
             indexing_data->filetypes_count,
-            &indexing_data->mx_indexing_shutdown
+            &indexing_data->mx_indexing_shutdown,
+            &options,
+            &indexing_data->index
         );
-        save_index_to_file(indexing_data->index_path, &indexing_data->index);
+        // There is no previous index to fall back on
+        if(!is_created) exit(EXIT_FAILURE);
+        save_new_index(indexing_data->index_path, &indexing_data->index);
+    }
+    if(program_args->shared_index_name != NULL && !indexing_data->index.is_partial)
+        shared_index_publish(&indexing_data->shared_index, &indexing_data->index);
+
+    // An outdated index file is rebuilt right away
+    rebuild_scheduler_init(
+        &indexing_data->rebuild_scheduler,
+        program_args->indexing_interval,
+        program_args->min_indexing_interval,
+        program_args->max_indexing_interval,
+        indexing_data->index.creation_time
+    );
+    if(indexing_data->index.is_partial) try_to_start_async_indexing(indexing_data);
+}
+
+// Clients never index, they query the directory indexed by the publisher
+void attach_to_shared_index(indexing_data_t* indexing_data, program_args_t* program_args) {
+    shared_index_t* shared = &indexing_data->shared_index;
+    if(!try_to_attach_shared_index(shared, program_args->client_index_name)) exit(EXIT_FAILURE);
+    if(!try_to_map_latest_generation(shared, &indexing_data->index)) {
+        fprintf(stderr, "No index has been published to %s yet!\n", shared->name);
+        shared_index_destroy(shared);
+        exit(EXIT_FAILURE);
     }
+
+    indexing_data->dir_path = shared->root_path;
+    rebuild_scheduler_init(
+        &indexing_data->rebuild_scheduler,
+        NO_INTERVAL_INDEXING,
+        program_args->min_indexing_interval,
+        program_args->max_indexing_interval,
+        indexing_data->index.creation_time
+    );
+}
+
+// Leaves the mutexes in the same state as the `exit` command does
+void finish_batch(indexing_data_t* indexing_data) {
+    pthread_mutex_lock(&indexing_data->mx_indexing_process);
+    pthread_mutex_unlock(&indexing_data->mx_indexing_shutdown);
 }
 
+// `periodic_indexing_thread_id` is NULL if the thread has not been started
 void cleanup(
     indexing_data_t* indexing_data,
     program_args_t* program_args,
-    pthread_t periodic_indexing_thread_id
+    pthread_t* periodic_indexing_thread_id
 ) {
-    if(program_args->indexing_interval != NO_INTERVAL_INDEXING) {
-        pthread_cancel(periodic_indexing_thread_id);
-        if(pthread_join(periodic_indexing_thread_id, NULL)) ERR("pthread_join");
+    if(periodic_indexing_thread_id != NULL) {
+        rebuild_scheduler_stop(&indexing_data->rebuild_scheduler);
+        if(pthread_join(*periodic_indexing_thread_id, NULL)) ERR("pthread_join");
     }
+    rebuild_scheduler_destroy(&indexing_data->rebuild_scheduler);
 
     pthread_mutex_destroy(&indexing_data->mx_indexing_shutdown);
     pthread_mutex_destroy(&indexing_data->mx_index);
     pthread_mutex_unlock(&indexing_data->mx_indexing_process);
     pthread_mutex_destroy(&indexing_data->mx_indexing_process);
+    throttle_destroy(&indexing_data->throttle);
+    query_cache_destroy(&indexing_data->query_cache);
+    time_index_destroy(&indexing_data->time_index);
+    thread_pool_destroy(&indexing_data->query_pool);
+    index_history_destroy(&indexing_data->index_history);
+    destroy_exclusion_rules(&indexing_data->exclusion_rules);
 
     destroy_index(&indexing_data->index);
+    shared_index_destroy(&indexing_data->shared_index);
     if(program_args->should_free_index_path)
         free(program_args->index_path);
 }
 
-pthread_t initialize_periodic_indexing_thread(
+// The thread is only started if periodic indexing is enabled
+bool try_to_start_periodic_indexing_thread(
     indexing_data_t* indexing_data,
     program_args_t* program_args,
-    periodic_indexing_args_t* periodic_indexing_args
+    pthread_t* thread_id
 ) {
-    pthread_t periodic_indexing_thread_id;
-    if(program_args->indexing_interval != NO_INTERVAL_INDEXING) {
-        periodic_indexing_args->indexing_data = indexing_data;
-        periodic_indexing_args->indexing_interval = program_args->indexing_interval;
-        pthread_create(
-            &periodic_indexing_thread_id,
-            NULL,
-            async_update_index_periodically,
-            periodic_indexing_args
-        );
-    }
-
-    return periodic_indexing_thread_id;
+    if(program_args->indexing_interval == NO_INTERVAL_INDEXING) return false;
+    if(pthread_create(thread_id, NULL, async_update_index_periodically, indexing_data))
+        ERR("pthread_create");
+    return true;
 }
@@ -0,0 +1,123 @@
+#include "case_fold.h"
+
+#include "output.h"
+
+void print_json_string(FILE* stream, char* string);
+
+void init_interactive_output(output_t* output) {
+    output->stream = NULL;
+    output->format = OUTPUT_TEXT;
+    output->query_number = 0;
+    output->defers_paging = false;
+    output->page_stream = NULL;
+    output->page = NULL;
+    output->page_len = 0;
+}
+
+void print_query_start(output_t* output, char* command) {
+    if(output->format != OUTPUT_JSON) return;
+    fprintf(output->stream, "{\"query\":%lu,\"command\":", output->query_number);
+    print_json_string(output->stream, command);
+    fputs("}\n", output->stream);
+}
+
+void print_query_end(output_t* output) {
+    if(output->format == OUTPUT_NUL) putc('\0', output->stream);
+}
+
+void print_file_record(output_t* output, FILE* stream, char* path, off_t size, char* type_name) {
+    switch(output->format) {
+        case OUTPUT_TEXT:
+            fprintf(stream, "Path: %s\n", path);
+            fprintf(stream, "Size: %lu\n", size);
+            fprintf(stream, "Type: %s\n", type_name);
+            break;
+        case OUTPUT_JSON:
+            fprintf(stream, "{\"query\":%lu,\"path\":", output->query_number);
+            print_json_string(stream, path);
+            fprintf(stream, ",\"size\":%lu,\"type\":", size);
+            print_json_string(stream, type_name);
+            fputs("}\n", stream);
+            break;
+        case OUTPUT_NUL:
+            fprintf(stream, "%s%c%lu%c%s%c", path, '\0', size, '\0', type_name, '\0');
+            break;
+    }
+}
+
+void print_filetype_count(output_t* output, FILE* stream, char* type_name, size_t count) {
+    switch(output->format) {
+        case OUTPUT_TEXT:
+            fprintf(stream, "%s \t\t\t %lu\n", type_name, count);
+            break;
+        case OUTPUT_JSON:
+            fprintf(stream, "{\"query\":%lu,\"type\":", output->query_number);
+            print_json_string(stream, type_name);
+            fprintf(stream, ",\"count\":%lu}\n", count);
+            break;
+        case OUTPUT_NUL:
+            fprintf(stream, "%s%c%lu%c", type_name, '\0', count, '\0');
+            break;
+    }
+}
+
+void print_directory_rollup(
+    output_t* output,
+    FILE* stream,
+    char* path,
+    off_t total_size,
+    char** type_names,
+    size_t* type_counts,
+    size_t types_count
+) {
+    switch(output->format) {
+        case OUTPUT_TEXT:
+            fprintf(stream, "Path: %s\n", path);
+            fprintf(stream, "Total size: %lu\n", total_size);
+            for(size_t i = 0; i < types_count; ++i)
+                fprintf(stream, "%s: %lu\n", type_names[i], type_counts[i]);
+            break;
+        case OUTPUT_JSON:
+            fprintf(stream, "{\"query\":%lu,\"path\":", output->query_number);
+            print_json_string(stream, path);
+            fprintf(stream, ",\"total_size\":%lu,\"counts\":{", total_size);
+            for(size_t i = 0; i < types_count; ++i) {
+                if(i != 0) putc(',', stream);
+                print_json_string(stream, type_names[i]);
+                fprintf(stream, ":%lu", type_counts[i]);
+            }
+            fputs("}}\n", stream);
+            break;
+        case OUTPUT_NUL:
+            fprintf(stream, "%s%c%lu%c", path, '\0', total_size, '\0');
+            for(size_t i = 0; i < types_count; ++i)
+                fprintf(stream, "%s%c%lu%c", type_names[i], '\0', type_counts[i], '\0');
+            break;
+    }
+}
+
+// JSON has to be valid UTF-8, bytes of names which are not are replaced with U+FFFD one by one
+void print_json_string(FILE* stream, char* string) {
+    putc_unlocked('"', stream);
+    while(*string != '\0') {
+        unsigned char c = *string;
+        size_t len = 1;
+        uint32_t code_point;
+        if(c == '"' || c == '\\') {
+            putc_unlocked('\\', stream);
+            putc_unlocked(c, stream);
+        }
+        else if(c < 0x20) fprintf(stream, "\\u%04x", c);
+        else if(c < 0x80) putc_unlocked(c, stream);
+        else {
+            len = decode_utf8((unsigned char*)string, &code_point);
+            if(len != 0) fwrite(string, 1, len, stream);
+            else {
+                fputs("\\ufffd", stream);
+                len = 1;
+            }
+        }
+        string += len;
+    }
+    putc_unlocked('"', stream);
+}
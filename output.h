@@ -0,0 +1,48 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+typedef enum output_format {
+    // Human readable output of the interactive console
+    OUTPUT_TEXT,
+    // One JSON object per line
+    OUTPUT_JSON,
+    // Fields terminated with NUL characters, an empty field terminates the results of a query
+    OUTPUT_NUL
+} output_format_t;
+
+typedef struct output {
+    // Stream all results are written to, NULL means stdout or the pager
+    FILE* stream;
+    output_format_t format;
+    // Number of the batch query being executed, JSON records are tagged with it
+    size_t query_number;
+    // Set while a command holds the index, output for the pager is then buffered in `page`
+    // and paged once the index has been released
+    bool defers_paging;
+    FILE* page_stream;
+    char* page;
+    size_t page_len;
+} output_t;
+
+void init_interactive_output(output_t* output);
+void print_query_start(output_t* output, char* command);
+void print_query_end(output_t* output);
+void print_file_record(output_t* output, FILE* stream, char* path, off_t size, char* type_name);
+void print_filetype_count(output_t* output, FILE* stream, char* type_name, size_t count);
+// `type_names` and `type_counts` contain `types_count` items
+void print_directory_rollup(
+    output_t* output,
+    FILE* stream,
+    char* path,
+    off_t total_size,
+    char** type_names,
+    size_t* type_counts,
+    size_t types_count
+);
+
+#endif
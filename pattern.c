@@ -0,0 +1,697 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "error.h"
+#include "hash.h"
+
+#include "pattern.h"
+
+#define CHARSET_LEN 32
+#define NO_STATE -1
+#define MAX_LITERAL_LEN 256LU
+// Power of two, large enough to keep the hash table of DFA states sparse
+#define DFA_TABLE_LEN (4 * MAX_DFA_STATES)
+#define GLOB_SPECIAL_CHARACTERS ".+()|^${}"
+
+typedef enum nfa_state_type {
+    NFA_CHARSET,
+    NFA_SPLIT,
+    NFA_EPSILON,
+    NFA_MATCH
+} nfa_state_type_t;
+
+typedef struct nfa_state {
+    nfa_state_type_t type;
+    int out;
+    // Second branch of NFA_SPLIT states
+    int alt_out;
+    uint8_t charset[CHARSET_LEN];
+} nfa_state_t;
+
+typedef struct nfa {
+    nfa_state_t* states;
+    size_t count;
+    size_t capacity;
+} nfa_t;
+
+// Part of the NFA with a single entry and a single exit.
+// The exit is an epsilon state whose `out` is set when the fragment is connected to the next one.
+typedef struct fragment {
+    int start;
+    int end;
+} fragment_t;
+
+typedef struct literal_run {
+    char chars[MAX_LITERAL_LEN + 1];
+    size_t len;
+    bool is_at_start;
+} literal_run_t;
+
+typedef struct parser {
+    char* pattern;
+    size_t position;
+    size_t end;
+    char* error;
+    nfa_t nfa;
+    // Runs of literal characters in the top level concatenation,
+    // every match has to contain the longest one
+    literal_run_t current_run;
+    literal_run_t longest_run;
+    bool has_top_level_alternation;
+} parser_t;
+
+typedef struct dfa_builder {
+    nfa_t* nfa;
+    size_t set_words;
+    // Sets of NFA states, `set_words` words for every DFA state
+    uint64_t* sets;
+    size_t states_capacity;
+    int table[DFA_TABLE_LEN];
+    uint64_t* next_set;
+    uint64_t* visited;
+    int* stack;
+} dfa_builder_t;
+
+char* translate_glob_to_regex(char* glob);
+char* join_glob_regexes(char** globs, size_t globs_count);
+size_t translate_glob_class(char* glob, size_t position, char* regex, size_t* regex_len);
+bool try_to_compile(char* regex, bool accepts_any_suffix, pattern_t* pattern);
+bool is_escaped(char* string, size_t position);
+void init_parser(parser_t* parser, char* regex);
+fragment_t parse_alternation(parser_t* parser, int depth);
+fragment_t parse_concatenation(parser_t* parser, int depth);
+fragment_t parse_repetition(parser_t* parser, int depth, int* literal, bool* is_optional);
+fragment_t parse_atom(parser_t* parser, int depth, int* literal);
+fragment_t parse_class(parser_t* parser);
+int parse_class_char(parser_t* parser);
+void extend_literal_run(parser_t* parser, int literal, bool is_first);
+void finish_literal_run(parser_t* parser);
+void set_parser_error(parser_t* parser, char* error);
+int add_nfa_state(nfa_t* nfa, nfa_state_type_t type);
+fragment_t make_epsilon(nfa_t* nfa);
+fragment_t make_charset(nfa_t* nfa, uint8_t* charset);
+fragment_t make_any_char(nfa_t* nfa);
+fragment_t concatenate(nfa_t* nfa, fragment_t first, fragment_t second);
+fragment_t alternate(nfa_t* nfa, fragment_t first, fragment_t second);
+fragment_t repeat_star(nfa_t* nfa, fragment_t fragment);
+fragment_t repeat_plus(nfa_t* nfa, fragment_t fragment);
+fragment_t make_optional(nfa_t* nfa, fragment_t fragment);
+void set_charset_bit(uint8_t* charset, int c);
+bool has_charset_bit(uint8_t* charset, int c);
+void compute_byte_classes(nfa_t* nfa, pattern_t* pattern, uint8_t* representatives);
+bool try_to_build_dfa(nfa_t* nfa, int start, int match, pattern_t* pattern);
+void compute_closure(dfa_builder_t* builder, uint64_t* set);
+int find_or_add_dfa_state(dfa_builder_t* builder, pattern_t* pattern, uint64_t* set);
+
+bool try_to_compile_glob(char* glob, pattern_t* pattern) {
+    char* regex = translate_glob_to_regex(glob);
+    bool is_compiled = try_to_compile(regex, false, pattern);
+    free(regex);
+    return is_compiled;
+}
+
+bool try_to_compile_glob_set(char** globs, size_t globs_count, pattern_t* pattern) {
+    char* regex = join_glob_regexes(globs, globs_count);
+    bool is_compiled = try_to_compile(regex, false, pattern);
+    free(regex);
+    return is_compiled;
+}
+
+// Translated globs are stripped of their anchors and joined into `^(g1|g2|...)$`
+char* join_glob_regexes(char** globs, size_t globs_count) {
+    size_t regex_capacity = 4;
+    for(size_t i = 0; i < globs_count; ++i) regex_capacity += 2 * strlen(globs[i]) + 1;
+    char* regex = malloc(regex_capacity);
+    if(regex == NULL) ERR("malloc");
+
+    size_t regex_len = 0;
+    regex[regex_len++] = '^';
+    regex[regex_len++] = '(';
+    for(size_t i = 0; i < globs_count; ++i) {
+        char* glob_regex = translate_glob_to_regex(globs[i]);
+        size_t glob_regex_len = strlen(glob_regex) - 2;
+        if(i > 0) regex[regex_len++] = '|';
+        memcpy(regex + regex_len, glob_regex + 1, glob_regex_len);
+        regex_len += glob_regex_len;
+        free(glob_regex);
+    }
+    regex[regex_len++] = ')';
+    regex[regex_len++] = '$';
+    regex[regex_len] = '\0';
+    return regex;
+}
+
+// Escapes characters which are special only in regexes and anchors the regex at both ends
+char* translate_glob_to_regex(char* glob) {
+    size_t glob_len = strlen(glob);
+    char* regex = malloc(2 * glob_len + 3);
+    if(regex == NULL) ERR("malloc");
+
+    size_t regex_len = 0;
+    regex[regex_len++] = '^';
+    for(size_t i = 0; i < glob_len; ++i) {
+        if(glob[i] == '*') {
+            regex[regex_len++] = '.';
+            regex[regex_len++] = '*';
+        }
+        else if(glob[i] == '?') regex[regex_len++] = '.';
+        else if(glob[i] == '[') i = translate_glob_class(glob, i, regex, &regex_len);
+        else if(glob[i] == '\\' && i + 1 < glob_len) {
+            regex[regex_len++] = '\\';
+            regex[regex_len++] = glob[++i];
+        }
+        else {
+            if(strchr(GLOB_SPECIAL_CHARACTERS "\\]", glob[i]) != NULL) regex[regex_len++] = '\\';
+            regex[regex_len++] = glob[i];
+        }
+    }
+    regex[regex_len++] = '$';
+    regex[regex_len] = '\0';
+    return regex;
+}
+
+// Copies a class starting at `position`, returns the position of its closing bracket.
+// A bracket without a matching closing one is a literal character.
+size_t translate_glob_class(char* glob, size_t position, char* regex, size_t* regex_len) {
+    size_t end = position + 1;
+    if(glob[end] == '!' || glob[end] == '^') ++end;
+    if(glob[end] == ']') ++end;
+    for(; glob[end] != '\0' && glob[end] != ']'; ++end)
+        if(glob[end] == '\\' && glob[end + 1] != '\0') ++end;
+
+    if(glob[end] == '\0') {
+        regex[(*regex_len)++] = '\\';
+        regex[(*regex_len)++] = '[';
+        return position;
+    }
+
+    regex[(*regex_len)++] = '[';
+    size_t i = position + 1;
+    if(glob[i] == '!' || glob[i] == '^') {
+        regex[(*regex_len)++] = '^';
+        ++i;
+    }
+    for(; i <= end; ++i) regex[(*regex_len)++] = glob[i];
+    return end;
+}
+
+bool try_to_compile_regex(char* regex, pattern_t* pattern) {
+    size_t regex_len = strlen(regex);
+    bool is_anchored_at_end =
+        regex_len > 0 && regex[regex_len - 1] == '$' && !is_escaped(regex, regex_len - 1);
+    return try_to_compile(regex, !is_anchored_at_end, pattern);
+}
+
+bool is_escaped(char* string, size_t position) {
+    size_t backslashes = 0;
+    while(position > backslashes && string[position - backslashes - 1] == '\\') ++backslashes;
+    return backslashes % 2 == 1;
+}
+
+bool try_to_compile(char* regex, bool accepts_any_suffix, pattern_t* pattern) {
+    parser_t parser;
+    init_parser(&parser, regex);
+    bool is_anchored_at_start = regex[0] == '^';
+    if(is_anchored_at_start) parser.position = 1;
+    if(!accepts_any_suffix) parser.end -= 1;
+
+    fragment_t fragment = parse_alternation(&parser, 0);
+    if(parser.error == NULL && parser.position != parser.end)
+        set_parser_error(&parser, "unmatched `)`");
+    // Anchors are applied to the whole pattern, which is not what `^a|b` means
+    if(parser.error == NULL &&
+        parser.has_top_level_alternation && (is_anchored_at_start || !accepts_any_suffix)
+    )
+        set_parser_error(&parser, "anchors next to a top-level `|` have to be grouped, e.g. `^(a|b)$`");
+    if(parser.error != NULL) {
+        fprintf(stderr, "Invalid pattern: %s!\n", parser.error);
+        free(parser.nfa.states);
+        return false;
+    }
+
+    // Unanchored patterns may start anywhere in the name
+    if(!is_anchored_at_start)
+        fragment = concatenate(
+            &parser.nfa, repeat_star(&parser.nfa, make_any_char(&parser.nfa)), fragment);
+    int match = add_nfa_state(&parser.nfa, NFA_MATCH);
+    parser.nfa.states[fragment.end].out = match;
+
+    literal_run_t* literal = &parser.longest_run;
+    if(parser.has_top_level_alternation) literal->len = 0;
+    literal->chars[literal->len] = '\0';
+    pattern->required_literal = strdup(literal->chars);
+    if(pattern->required_literal == NULL) ERR("strdup");
+    pattern->required_literal_len = literal->len;
+    pattern->is_literal_prefix = is_anchored_at_start && literal->is_at_start;
+    pattern->accepts_any_suffix = accepts_any_suffix;
+
+    bool is_built = try_to_build_dfa(&parser.nfa, fragment.start, match, pattern);
+    free(parser.nfa.states);
+    if(!is_built) {
+        fprintf(stderr, "Invalid pattern: more than %lu automaton states needed!\n", MAX_DFA_STATES);
+        free(pattern->required_literal);
+    }
+    return is_built;
+}
+
+void init_parser(parser_t* parser, char* regex) {
+    parser->pattern = regex;
+    parser->position = 0;
+    parser->end = strlen(regex);
+    parser->error = NULL;
+    parser->nfa = (nfa_t){ .states = NULL, .count = 0, .capacity = 0 };
+    parser->current_run.len = 0;
+    parser->longest_run.len = 0;
+    parser->longest_run.is_at_start = false;
+    parser->has_top_level_alternation = false;
+}
+
+fragment_t parse_alternation(parser_t* parser, int depth) {
+    fragment_t fragment = parse_concatenation(parser, depth);
+    while(parser->error == NULL &&
+        parser->position < parser->end && parser->pattern[parser->position] == '|'
+    ) {
+        parser->position += 1;
+        if(depth == 0) parser->has_top_level_alternation = true;
+        fragment = alternate(&parser->nfa, fragment, parse_concatenation(parser, depth));
+    }
+
+    return fragment;
+}
+
+fragment_t parse_concatenation(parser_t* parser, int depth) {
+    fragment_t fragment = make_epsilon(&parser->nfa);
+    bool is_first = true;
+    while(parser->error == NULL && parser->position < parser->end) {
+        char c = parser->pattern[parser->position];
+        if(c == '|' || (c == ')' && depth > 0)) break;
+        if(c == ')') {
+            set_parser_error(parser, "unmatched `)`");
+            break;
+        }
+
+        int literal;
+        bool is_optional;
+        fragment_t repetition = parse_repetition(parser, depth, &literal, &is_optional);
+        fragment = concatenate(&parser->nfa, fragment, repetition);
+        if(depth == 0) {
+            if(is_optional) literal = NO_STATE;
+            extend_literal_run(parser, literal, is_first);
+        }
+        is_first = false;
+    }
+
+    if(depth == 0) finish_literal_run(parser);
+    return fragment;
+}
+
+// `literal` is set to the character if the atom is a single literal character, NO_STATE otherwise.
+// `is_optional` is set if the atom may be absent from a match.
+fragment_t parse_repetition(parser_t* parser, int depth, int* literal, bool* is_optional) {
+    fragment_t fragment = parse_atom(parser, depth, literal);
+    *is_optional = false;
+    bool is_repeated = false;
+    while(parser->error == NULL && parser->position < parser->end) {
+        char c = parser->pattern[parser->position];
+        if(c == '*') fragment = repeat_star(&parser->nfa, fragment);
+        else if(c == '+') fragment = repeat_plus(&parser->nfa, fragment);
+        else if(c == '?') fragment = make_optional(&parser->nfa, fragment);
+        else break;
+
+        *is_optional = *is_optional || c == '*' || c == '?';
+        is_repeated = true;
+        parser->position += 1;
+    }
+
+    // A repeated literal is required once, but it ends the run of literals
+    if(depth == 0 && is_repeated && !*is_optional && *literal != NO_STATE) {
+        extend_literal_run(parser, *literal, false);
+        finish_literal_run(parser);
+        *literal = NO_STATE;
+        *is_optional = true;
+    }
+
+    return fragment;
+}
+
+fragment_t parse_atom(parser_t* parser, int depth, int* literal) {
+    *literal = NO_STATE;
+    char c = parser->pattern[parser->position++];
+    switch(c) {
+        case '(': {
+            fragment_t fragment = parse_alternation(parser, depth + 1);
+            if(parser->error == NULL &&
+                (parser->position >= parser->end || parser->pattern[parser->position] != ')')
+            )
+                set_parser_error(parser, "missing `)`");
+            parser->position += 1;
+            return fragment;
+        }
+        case '[':
+            return parse_class(parser);
+        case '.':
+            return make_any_char(&parser->nfa);
+        case '*':
+        case '+':
+        case '?':
+            set_parser_error(parser, "nothing to repeat");
+            return make_epsilon(&parser->nfa);
+        case '^':
+        case '$':
+            set_parser_error(parser, "anchors are supported only at the ends of the pattern");
+            return make_epsilon(&parser->nfa);
+        case '\\':
+            if(parser->position >= parser->end) {
+                set_parser_error(parser, "trailing `\\`");
+                return make_epsilon(&parser->nfa);
+            }
+            c = parser->pattern[parser->position++];
+            break;
+    }
+
+    *literal = (unsigned char)c;
+    uint8_t charset[CHARSET_LEN] = { 0 };
+    set_charset_bit(charset, *literal);
+    return make_charset(&parser->nfa, charset);
+}
+
+fragment_t parse_class(parser_t* parser) {
+    uint8_t charset[CHARSET_LEN] = { 0 };
+    bool is_negated = parser->position < parser->end && parser->pattern[parser->position] == '^';
+    if(is_negated) parser->position += 1;
+
+    bool is_first = true;
+    while(parser->error == NULL &&
+        (is_first || parser->pattern[parser->position] != ']')
+    ) {
+        if(parser->position >= parser->end) {
+            set_parser_error(parser, "missing `]`");
+            break;
+        }
+
+        int first = parse_class_char(parser);
+        int last = first;
+        bool is_range =
+            parser->position + 1 < parser->end &&
+            parser->pattern[parser->position] == '-' &&
+            parser->pattern[parser->position + 1] != ']';
+        if(is_range) {
+            parser->position += 1;
+            last = parse_class_char(parser);
+        }
+        for(int c = first; c <= last; ++c) set_charset_bit(charset, c);
+        is_first = false;
+    }
+
+    parser->position += 1;
+    if(is_negated) {
+        for(size_t i = 0; i < CHARSET_LEN; ++i) charset[i] = ~charset[i];
+    }
+    return make_charset(&parser->nfa, charset);
+}
+
+int parse_class_char(parser_t* parser) {
+    char c = parser->pattern[parser->position++];
+    if(c == '\\' && parser->position < parser->end) c = parser->pattern[parser->position++];
+    return (unsigned char)c;
+}
+
+void extend_literal_run(parser_t* parser, int literal, bool is_first) {
+    literal_run_t* run = &parser->current_run;
+    if(literal == NO_STATE || run->len == MAX_LITERAL_LEN) {
+        finish_literal_run(parser);
+        return;
+    }
+
+    if(run->len == 0) run->is_at_start = is_first;
+    run->chars[run->len++] = literal;
+}
+
+void finish_literal_run(parser_t* parser) {
+    if(parser->current_run.len > parser->longest_run.len)
+        parser->longest_run = parser->current_run;
+    parser->current_run.len = 0;
+}
+
+void set_parser_error(parser_t* parser, char* error) {
+    if(parser->error == NULL) parser->error = error;
+}
+
+int add_nfa_state(nfa_t* nfa, nfa_state_type_t type) {
+    if(nfa->count == nfa->capacity) {
+        nfa->capacity = nfa->capacity == 0 ? 16 : 2 * nfa->capacity;
+        nfa->states = realloc(nfa->states, nfa->capacity * sizeof(nfa_state_t));
+        if(nfa->states == NULL) ERR("realloc");
+    }
+
+    nfa_state_t* state = &nfa->states[nfa->count];
+    state->type = type;
+    state->out = NO_STATE;
+    state->alt_out = NO_STATE;
+    memset(state->charset, 0, CHARSET_LEN);
+    return nfa->count++;
+}
+
+fragment_t make_epsilon(nfa_t* nfa) {
+    int state = add_nfa_state(nfa, NFA_EPSILON);
+    return (fragment_t){ .start = state, .end = state };
+}
+
+fragment_t make_charset(nfa_t* nfa, uint8_t* charset) {
+    int start = add_nfa_state(nfa, NFA_CHARSET);
+    int end = add_nfa_state(nfa, NFA_EPSILON);
+    memcpy(nfa->states[start].charset, charset, CHARSET_LEN);
+    nfa->states[start].out = end;
+    return (fragment_t){ .start = start, .end = end };
+}
+
+// Names never contain NUL characters
+fragment_t make_any_char(nfa_t* nfa) {
+    uint8_t charset[CHARSET_LEN];
+    memset(charset, 0xff, CHARSET_LEN);
+    charset[0] &= ~1;
+    return make_charset(nfa, charset);
+}
+
+fragment_t concatenate(nfa_t* nfa, fragment_t first, fragment_t second) {
+    nfa->states[first.end].out = second.start;
+    return (fragment_t){ .start = first.start, .end = second.end };
+}
+
+fragment_t alternate(nfa_t* nfa, fragment_t first, fragment_t second) {
+    int split = add_nfa_state(nfa, NFA_SPLIT);
+    int end = add_nfa_state(nfa, NFA_EPSILON);
+    nfa->states[split].out = first.start;
+    nfa->states[split].alt_out = second.start;
+    nfa->states[first.end].out = end;
+    nfa->states[second.end].out = end;
+    return (fragment_t){ .start = split, .end = end };
+}
+
+fragment_t repeat_star(nfa_t* nfa, fragment_t fragment) {
+    int split = add_nfa_state(nfa, NFA_SPLIT);
+    int end = add_nfa_state(nfa, NFA_EPSILON);
+    nfa->states[split].out = fragment.start;
+    nfa->states[split].alt_out = end;
+    nfa->states[fragment.end].out = split;
+    return (fragment_t){ .start = split, .end = end };
+}
+
+fragment_t repeat_plus(nfa_t* nfa, fragment_t fragment) {
+    int split = add_nfa_state(nfa, NFA_SPLIT);
+    int end = add_nfa_state(nfa, NFA_EPSILON);
+    nfa->states[split].out = fragment.start;
+    nfa->states[split].alt_out = end;
+    nfa->states[fragment.end].out = split;
+    return (fragment_t){ .start = fragment.start, .end = end };
+}
+
+fragment_t make_optional(nfa_t* nfa, fragment_t fragment) {
+    int split = add_nfa_state(nfa, NFA_SPLIT);
+    int end = add_nfa_state(nfa, NFA_EPSILON);
+    nfa->states[split].out = fragment.start;
+    nfa->states[split].alt_out = end;
+    nfa->states[fragment.end].out = end;
+    return (fragment_t){ .start = split, .end = end };
+}
+
+void set_charset_bit(uint8_t* charset, int c) {
+    charset[c / 8] |= 1 << (c % 8);
+}
+
+bool has_charset_bit(uint8_t* charset, int c) {
+    return (charset[c / 8] >> (c % 8)) & 1;
+}
+
+// Bytes which belong to exactly the same character sets are interchangeable,
+// so the DFA needs only one column for each such class of bytes
+void compute_byte_classes(nfa_t* nfa, pattern_t* pattern, uint8_t* representatives) {
+    memset(pattern->byte_classes, 0, sizeof(pattern->byte_classes));
+    pattern->class_count = 1;
+    for(size_t i = 0; i < nfa->count; ++i) {
+        if(nfa->states[i].type != NFA_CHARSET) continue;
+        int refined[2 * 256];
+        for(size_t j = 0; j < 2 * 256; ++j) refined[j] = NO_STATE;
+        size_t refined_count = 0;
+        for(int c = 0; c < 256; ++c) {
+            int key = 2 * pattern->byte_classes[c] + has_charset_bit(nfa->states[i].charset, c);
+            if(refined[key] == NO_STATE) refined[key] = refined_count++;
+            pattern->byte_classes[c] = refined[key];
+        }
+        pattern->class_count = refined_count;
+    }
+
+    for(int c = 255; c >= 0; --c) representatives[pattern->byte_classes[c]] = c;
+}
+
+// Subset construction, DFA states are identified by sets of NFA states
+bool try_to_build_dfa(nfa_t* nfa, int start, int match, pattern_t* pattern) {
+    uint8_t representatives[256];
+    compute_byte_classes(nfa, pattern, representatives);
+
+    dfa_builder_t builder = {
+        .nfa = nfa,
+        .set_words = (nfa->count + 63) / 64,
+        .sets = NULL,
+        .states_capacity = 0
+    };
+    for(size_t i = 0; i < DFA_TABLE_LEN; ++i) builder.table[i] = NO_STATE;
+    builder.next_set = malloc(builder.set_words * sizeof(uint64_t));
+    builder.visited = malloc(builder.set_words * sizeof(uint64_t));
+    builder.stack = malloc(nfa->count * sizeof(int));
+    if(builder.next_set == NULL || builder.visited == NULL || builder.stack == NULL)
+        ERR("malloc");
+
+    pattern->transitions = NULL;
+    pattern->is_accepting = NULL;
+    pattern->state_count = 0;
+
+    memset(builder.next_set, 0, builder.set_words * sizeof(uint64_t));
+    find_or_add_dfa_state(&builder, pattern, builder.next_set);
+    builder.next_set[start / 64] |= 1LLU << (start % 64);
+    compute_closure(&builder, builder.next_set);
+    pattern->start_state = find_or_add_dfa_state(&builder, pattern, builder.next_set);
+
+    bool is_built = true;
+    for(size_t state = 0; state < pattern->state_count && is_built; ++state) {
+        uint64_t* set = &builder.sets[state * builder.set_words];
+        pattern->is_accepting[state] = (set[match / 64] >> (match % 64)) & 1;
+        for(size_t byte_class = 0; byte_class < pattern->class_count; ++byte_class) {
+            memset(builder.next_set, 0, builder.set_words * sizeof(uint64_t));
+            for(size_t i = 0; i < nfa->count; ++i) {
+                bool is_in_set = (set[i / 64] >> (i % 64)) & 1;
+                if(!is_in_set || nfa->states[i].type != NFA_CHARSET) continue;
+                if(!has_charset_bit(nfa->states[i].charset, representatives[byte_class])) continue;
+                int out = nfa->states[i].out;
+                builder.next_set[out / 64] |= 1LLU << (out % 64);
+            }
+            compute_closure(&builder, builder.next_set);
+            int next_state = find_or_add_dfa_state(&builder, pattern, builder.next_set);
+            if(next_state == NO_STATE) {
+                is_built = false;
+                break;
+            }
+            // `sets` may have been reallocated
+            set = &builder.sets[state * builder.set_words];
+            pattern->transitions[state * pattern->class_count + byte_class] = next_state;
+        }
+    }
+
+    free(builder.sets);
+    free(builder.next_set);
+    free(builder.visited);
+    free(builder.stack);
+    if(!is_built) {
+        free(pattern->transitions);
+        free(pattern->is_accepting);
+    }
+    return is_built;
+}
+
+// Extends the set with all states reachable through epsilon transitions.
+// Only character sets and the match state are kept, so that equal DFA states have equal sets.
+void compute_closure(dfa_builder_t* builder, uint64_t* set) {
+    nfa_state_t* states = builder->nfa->states;
+    size_t stack_size = 0;
+    memset(builder->visited, 0, builder->set_words * sizeof(uint64_t));
+    for(size_t i = 0; i < builder->nfa->count; ++i) {
+        if(!((set[i / 64] >> (i % 64)) & 1)) continue;
+        builder->visited[i / 64] |= 1LLU << (i % 64);
+        builder->stack[stack_size++] = i;
+    }
+
+    memset(set, 0, builder->set_words * sizeof(uint64_t));
+    while(stack_size > 0) {
+        int state = builder->stack[--stack_size];
+        if(states[state].type == NFA_CHARSET || states[state].type == NFA_MATCH) {
+            set[state / 64] |= 1LLU << (state % 64);
+            continue;
+        }
+
+        int outs[] = { states[state].out, states[state].alt_out };
+        for(size_t i = 0; i < 2; ++i) {
+            int out = outs[i];
+            if(out == NO_STATE || ((builder->visited[out / 64] >> (out % 64)) & 1)) continue;
+            builder->visited[out / 64] |= 1LLU << (out % 64);
+            builder->stack[stack_size++] = out;
+        }
+    }
+}
+
+// Returns NO_STATE if the DFA would be too large
+int find_or_add_dfa_state(dfa_builder_t* builder, pattern_t* pattern, uint64_t* set) {
+    size_t set_len = builder->set_words * sizeof(uint64_t);
+    size_t slot = hash_buffer((char*)set, set_len) & (DFA_TABLE_LEN - 1);
+    for(; builder->table[slot] != NO_STATE; slot = (slot + 1) & (DFA_TABLE_LEN - 1)) {
+        int state = builder->table[slot];
+        if(memcmp(&builder->sets[state * builder->set_words], set, set_len) == 0) return state;
+    }
+
+    if(pattern->state_count == MAX_DFA_STATES) return NO_STATE;
+    if(pattern->state_count == builder->states_capacity) {
+        builder->states_capacity = builder->states_capacity == 0 ? 16 : 2 * builder->states_capacity;
+        builder->sets = realloc(builder->sets, builder->states_capacity * set_len);
+        pattern->transitions = realloc(
+            pattern->transitions,
+            builder->states_capacity * pattern->class_count * sizeof(uint16_t)
+        );
+        pattern->is_accepting =
+            realloc(pattern->is_accepting, builder->states_capacity * sizeof(bool));
+        if(builder->sets == NULL || pattern->transitions == NULL || pattern->is_accepting == NULL)
+            ERR("realloc");
+    }
+
+    int state = pattern->state_count++;
+    memcpy(&builder->sets[state * builder->set_words], set, set_len);
+    builder->table[slot] = state;
+    return state;
+}
+
+bool pattern_matches(pattern_t* pattern, char* name) {
+    // Cheap literal checks reject most names before the automaton is run
+    if(pattern->required_literal_len != 0) {
+        if(pattern->is_literal_prefix) {
+            if(strncmp(name, pattern->required_literal, pattern->required_literal_len) != 0)
+                return false;
+        }
+        else if(strstr(name, pattern->required_literal) == NULL) return false;
+    }
+
+    uint16_t state = pattern->start_state;
+    for(;; ++name) {
+        if(pattern->accepts_any_suffix && pattern->is_accepting[state]) return true;
+        if(*name == '\0') return pattern->is_accepting[state];
+        state = pattern->transitions[
+            state * pattern->class_count + pattern->byte_classes[(unsigned char)*name]];
+        if(state == DEAD_DFA_STATE) return false;
+    }
+}
+
+void destroy_pattern(pattern_t* pattern) {
+    free(pattern->transitions);
+    free(pattern->is_accepting);
+    free(pattern->required_literal);
+    pattern->transitions = NULL;
+    pattern->is_accepting = NULL;
+    pattern->required_literal = NULL;
+}
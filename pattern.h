@@ -0,0 +1,41 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MAX_DFA_STATES 4096LU
+#define DEAD_DFA_STATE 0
+
+// Name pattern compiled into a deterministic automaton.
+// Matching is a single pass over the name, without backtracking or allocation.
+typedef struct pattern {
+    // `transitions[state * class_count + byte_classes[byte]]` is the next state
+    uint16_t* transitions;
+    bool* is_accepting;
+    size_t state_count;
+    uint8_t byte_classes[256];
+    size_t class_count;
+    uint16_t start_state;
+    // Once an accepting state is reached, the rest of the name does not matter
+    bool accepts_any_suffix;
+    // Substring every matching name contains, empty if there is none
+    char* required_literal;
+    size_t required_literal_len;
+    // Set if every matching name starts with `required_literal`
+    bool is_literal_prefix;
+} pattern_t;
+
+// Globs match whole names: `*` matches any string, `?` any character,
+// `[...]` (negated with `!` or `^`) a character class and `\` escapes the next character.
+bool try_to_compile_glob(char* glob, pattern_t* pattern);
+// Compiles globs into a single automaton matching names which match any of them
+bool try_to_compile_glob_set(char** globs, size_t globs_count, pattern_t* pattern);
+// Regexes match anywhere in the name, unless anchored with `^` at the start or `$` at the end.
+// Supported are `.`, `[...]` classes, `*`, `+`, `?`, `|`, groups and `\` escapes.
+bool try_to_compile_regex(char* regex, pattern_t* pattern);
+bool pattern_matches(pattern_t* pattern, char* name);
+void destroy_pattern(pattern_t* pattern);
+
+#endif
@@ -5,17 +5,25 @@
 
 #include "error.h"
 
+#include "shared_index.h"
+
 #include "program_args.h"
 
 #define DEFAULT_INDEX_FILENAME ".maulwurf_index"
 #define MIN_INDEXING_INTERVAL 30
 #define MAX_INDEXING_INTERVAL 7200
+#define MEBIBYTE (1024LU * 1024LU)
+#define DEFAULT_TRAVERSAL_THREADS 4
+#define MAX_TRAVERSAL_THREADS 64
 
 void parse_program_args(int argc, char** argv, program_args_t* program_args);
 char* get_default_dir_path();
 char* get_default_index_path(bool* should_be_freed);
 char* get_fallback_index_path();
+output_format_t parse_output_format(char* format, char* program_path);
+void parse_interval_bounds(char* bounds, program_args_t* program_args, char* program_path);
 bool are_args_correct(program_args_t* program_args);
+bool are_shared_index_args_correct(program_args_t* program_args);
 void usage(char* program_path);
 
 void get_program_args(int argc, char** argv, program_args_t* program_args) {
@@ -32,10 +40,24 @@ void get_program_args(int argc, char** argv, program_args_t* program_args) {
 
 void parse_program_args(int argc, char** argv, program_args_t* program_args) {
     program_args->indexing_interval = NO_INTERVAL_INDEXING;
+    program_args->min_indexing_interval = MIN_INDEXING_INTERVAL;
+    program_args->max_indexing_interval = MAX_INDEXING_INTERVAL;
     program_args->dir_path = NULL;
     program_args->index_path = NULL;
+    program_args->ops_per_second = 0.0;
+    program_args->bytes_per_second = 0.0;
+    program_args->batch_path = NULL;
+    program_args->output_format = OUTPUT_JSON;
+    program_args->memory_budget = 0;
+    program_args->traversal_threads = DEFAULT_TRAVERSAL_THREADS;
+    program_args->one_file_system = false;
+    program_args->sort_by_inode = false;
+    program_args->network_dont_sync = false;
+    program_args->exclusion_rules_path = NULL;
+    program_args->shared_index_name = NULL;
+    program_args->client_index_name = NULL;
     int opt;
-    while((opt = getopt(argc, argv, "d:f:t:")) != -1) {
+    while((opt = getopt(argc, argv, "d:f:t:T:o:b:B:F:m:j:E:S:C:xin")) != -1) {
         switch(opt) {
             case 'd':
                 program_args->dir_path = optarg;
@@ -46,6 +68,47 @@ void parse_program_args(int argc, char** argv, program_args_t* program_args) {
             case 't':
                 program_args->indexing_interval = atoi(optarg);
                 break;
+            case 'T':
+                parse_interval_bounds(optarg, program_args, argv[0]);
+                break;
+            case 'o':
+                program_args->ops_per_second = atof(optarg);
+                break;
+            case 'b':
+                program_args->bytes_per_second = atof(optarg);
+                break;
+            case 'B':
+                program_args->batch_path = optarg;
+                break;
+            case 'F':
+                program_args->output_format = parse_output_format(optarg, argv[0]);
+                break;
+            case 'm':
+                if(atol(optarg) <= 0) usage(argv[0]);
+                program_args->memory_budget = atol(optarg) * MEBIBYTE;
+                break;
+            case 'j':
+                if(atoi(optarg) <= 0 || atoi(optarg) > MAX_TRAVERSAL_THREADS) usage(argv[0]);
+                program_args->traversal_threads = atoi(optarg);
+                break;
+            case 'E':
+                program_args->exclusion_rules_path = optarg;
+                break;
+            case 'S':
+                program_args->shared_index_name = optarg;
+                break;
+            case 'C':
+                program_args->client_index_name = optarg;
+                break;
+            case 'x':
+                program_args->one_file_system = true;
+                break;
+            case 'i':
+                program_args->sort_by_inode = true;
+                break;
+            case 'n':
+                program_args->network_dont_sync = true;
+                break;
             case '?':
                 usage(argv[0]);
                 break;
@@ -53,6 +116,26 @@ void parse_program_args(int argc, char** argv, program_args_t* program_args) {
     }
 
     if(argc > optind) usage(argv[0]);
+    // Batch mode answers all queries from one index, it is never rebuilt in the meantime
+    if(program_args->batch_path != NULL) program_args->indexing_interval = NO_INTERVAL_INDEXING;
+}
+
+output_format_t parse_output_format(char* format, char* program_path) {
+    if(strcmp(format, "json") == 0) return OUTPUT_JSON;
+    if(strcmp(format, "nul") == 0) return OUTPUT_NUL;
+    usage(program_path);
+    return OUTPUT_TEXT;
+}
+
+// `bounds` are given as `min:max`
+void parse_interval_bounds(char* bounds, program_args_t* program_args, char* program_path) {
+    if(sscanf(
+        bounds,
+        "%d:%d",
+        &program_args->min_indexing_interval,
+        &program_args->max_indexing_interval
+    ) != 2)
+        usage(program_path);
 }
 
 char* get_default_dir_path() {
@@ -84,28 +167,79 @@ char* get_fallback_index_path() {
 }
 
 bool are_args_correct(program_args_t* program_args) {
+    bool are_interval_bounds_correct =
+        program_args->min_indexing_interval >= MIN_INDEXING_INTERVAL &&
+        program_args->max_indexing_interval <= MAX_INDEXING_INTERVAL &&
+        program_args->min_indexing_interval <= program_args->max_indexing_interval;
     bool is_indexing_interval_within_range =
-        program_args->indexing_interval <= MAX_INDEXING_INTERVAL &&
-        program_args->indexing_interval >= MIN_INDEXING_INTERVAL;
+        program_args->indexing_interval <= program_args->max_indexing_interval &&
+        program_args->indexing_interval >= program_args->min_indexing_interval;
 
     return
+        are_interval_bounds_correct &&
         (is_indexing_interval_within_range ||
         program_args->indexing_interval == NO_INTERVAL_INDEXING) &&
-        program_args->dir_path != NULL &&
+        program_args->ops_per_second >= 0.0 &&
+        program_args->bytes_per_second >= 0.0 &&
+        are_shared_index_args_correct(program_args) &&
+        // Clients query the directory indexed by the publisher
+        (program_args->dir_path != NULL || program_args->client_index_name != NULL) &&
         program_args->index_path != NULL;
 }
 
+bool are_shared_index_args_correct(program_args_t* program_args) {
+    if(program_args->client_index_name != NULL)
+        return
+            program_args->shared_index_name == NULL &&
+            program_args->indexing_interval == NO_INTERVAL_INDEXING &&
+            is_shared_index_name_valid(program_args->client_index_name);
+
+    return
+        program_args->shared_index_name == NULL ||
+        is_shared_index_name_valid(program_args->shared_index_name);
+}
+
 void usage(char* program_path) {
     fprintf(stderr,
         "Invalid use of %s!\nUsage: "
         "%s [-d indexing directory] "
         "[-f path to index file] "
-        "[-t 30 =< indexing interval =< 7200]\n"
+        "[-t 30 =< indexing interval =< 7200] "
+        "[-T min:max indexing interval] "
+        "[-o indexing operations per second] "
+        "[-b indexing bytes read per second] "
+        "[-B batch file] "
+        "[-F json|nul] "
+        "[-m indexing memory budget in MiB] "
+        "[-j 1 =< indexing threads =< 64] "
+        "[-E exclusion rules file] "
+        "[-S shared index name | -C shared index name] "
+        "[-x] "
+        "[-i] "
+        "[-n]\n"
         "If -d is omitted, MAULWURF_DIR enviroment variable has to be set."
         "Then, its value is taken instead.\n"
         "If -f is omitted, the value of MAULWURF_INDEX_PATH enviroment variable is taken instead. "
         "If MAULWURF_INDEX_PATH is not set and -f is omitted, HOME enviroment variable has to be set."
-        "Then, `$HOME/.maulwurf_index` is used."
+        "Then, `$HOME/.maulwurf_index` is used.\n"
+        "If -t is specified, the index is rebuilt periodically. The interval adapts to the number "
+        "of files changed by rebuilds within the bounds given by -T (30:7200 by default).\n"
+        "If -o or -b is specified, indexing is throttled to the given budget, "
+        "runs with idle I/O priority and does not pollute the page cache.\n"
+        "If -B is specified, queries are read from the given file (- for stdin) and executed "
+        "without prompts, results are printed as JSON lines or NUL-separated fields (-F).\n"
+        "If -m is specified, indexing spills sorted runs of files to temporary files "
+        "once the budget is used up and the index is served from the mapped index file.\n"
+        "Directories are indexed by -j threads (4 by default), network mounts can occupy "
+        "at most half of them. If -x is specified, other file systems are not descended into.\n"
+        "If -i is specified, directory entries are examined in the order of their inodes.\n"
+        "If -n is specified, attributes of files on network file systems cached by the client "
+        "are used without revalidating them with the server.\n"
+        "If -E is specified, files are excluded from indexing by the rules in the given file, "
+        "one per line: `name glob`, `path prefix` or `depth n`.\n"
+        "If -S is specified, every index is published to shared memory under the given name. "
+        "If -C is specified, nothing is indexed, queries are answered from the latest index "
+        "published under the given name."
         "\n",
         program_path, program_path
     );
@@ -3,13 +3,36 @@
 
 #include <stdbool.h>
 
+#include "output.h"
+
 #define NO_INTERVAL_INDEXING -1
 
 typedef struct program_args {
+    // Initial interval of periodic indexing, it is adapted within the bounds
     int indexing_interval;
+    int min_indexing_interval;
+    int max_indexing_interval;
     char* dir_path;
     char* index_path;
     bool should_free_index_path;
+    // Limits of throttled indexing, 0 means no limit
+    double ops_per_second;
+    double bytes_per_second;
+    // Batch mode is used if not NULL
+    char* batch_path;
+    output_format_t output_format;
+    // Bytes of memory indexing can use, 0 means no limit
+    size_t memory_budget;
+    size_t traversal_threads;
+    bool one_file_system;
+    bool sort_by_inode;
+    bool network_dont_sync;
+    // File with exclusion rules, nothing is excluded if NULL
+    char* exclusion_rules_path;
+    // Name of the shared index every generation is published to, NULL if it is not shared
+    char* shared_index_name;
+    // Name of the shared index queried in client mode, NULL if the index is built by this process
+    char* client_index_name;
 } program_args_t;
 
 void get_program_args(int argc, char** argv, program_args_t* program_args);
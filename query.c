@@ -0,0 +1,615 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "error.h"
+#include "commands.h"
+#include "case_fold.h"
+#include "query_executor.h"
+
+#include "query.h"
+
+typedef bool (*query_parser_t) (char* args, query_t* query);
+
+typedef struct query_type {
+    char* name;
+    query_parser_t parse;
+} query_type_t;
+
+size_t get_query_types(query_type_t** query_types);
+bool parse_largerthan_query(char* args, query_t* query);
+bool largerthan_filter(file_t* file, void* min_size);
+bool parse_namepart_query(char* args, query_t* query);
+bool namepart_filter(file_t* file, void* namepart);
+bool parse_owner_query(char* args, query_t* query);
+bool owner_filter(file_t* file, void* uid);
+bool parse_nameglob_query(char* args, query_t* query);
+bool parse_nameregex_query(char* args, query_t* query);
+bool name_pattern_filter(file_t* file, void* pattern);
+bool parse_inamepart_query(char* args, query_t* query);
+bool folded_namepart_filter(file_t* file, void* namepart);
+bool parse_inameglob_query(char* args, query_t* query);
+bool parse_inameregex_query(char* args, query_t* query);
+bool folded_name_pattern_filter(file_t* file, void* pattern);
+char* fold_query_args(char* args);
+bool parse_newerthan_query(char* args, query_t* query);
+bool parse_olderthan_query(char* args, query_t* query);
+bool parse_time_bound_query(char* cmd_name, char* args, bool is_newer, query_t* query);
+bool try_to_parse_time_field(char* str, time_field_t* field);
+bool try_to_parse_timestamp(char* str, time_t* timestamp);
+bool try_to_parse_relative_time(char* str, time_t* timestamp);
+bool try_to_parse_date(char* str, time_t* timestamp);
+bool time_bound_filter(file_t* file, void* time_bound);
+size_t select_by_time(indexing_data_t* data, void* time_bound, size_t* file_ids);
+bool all_files_filter(file_t* file, void* data);
+char* make_query_key(char* cmd_name, char* normalized_args);
+bool get_query_results(
+    indexing_data_t* data,
+    query_t* query,
+    size_t** file_ids,
+    size_t* files_count
+);
+size_t restrict_to_range(size_t* file_ids, size_t files_count, file_range_t* range);
+size_t find_first_id_not_below(size_t* file_ids, size_t files_count, size_t id);
+void print_sorted_files(
+    indexing_data_t* data,
+    size_t* file_ids,
+    size_t files_count,
+    heap_compare_t compare
+);
+void print_top_files(indexing_data_t* data, query_t* query, ordering_t* ordering);
+void print_files(indexing_data_t* data, size_t* file_ids, size_t files_count, FILE* stream);
+void print_file_pointers(indexing_data_t* data, file_t** files, size_t files_count);
+int compare_positions(const file_t* a, const file_t* b);
+
+size_t get_query_types(query_type_t** query_types) {
+    static query_type_t st_query_types[] = {
+        { "largerthan", parse_largerthan_query },
+        { "namepart", parse_namepart_query },
+        { "owner", parse_owner_query },
+        { "nameglob", parse_nameglob_query },
+        { "nameregex", parse_nameregex_query },
+        { "inamepart", parse_inamepart_query },
+        { "inameglob", parse_inameglob_query },
+        { "inameregex", parse_inameregex_query },
+        { "newerthan", parse_newerthan_query },
+        { "olderthan", parse_olderthan_query }
+    };
+
+    *query_types = st_query_types;
+    return sizeof(st_query_types) / sizeof(query_type_t);
+}
+
+bool try_to_parse_query(char* query_str, query_t* query) {
+    query->has_pattern = false;
+    query->select = NULL;
+    if(query_str == NULL) {
+        query->key = make_query_key("all", "");
+        query->filter = all_files_filter;
+        query->filter_data = NULL;
+        return true;
+    }
+
+    query_type_t* query_types = NULL;
+    size_t query_type_count = get_query_types(&query_types);
+    for(size_t i = 0; i < query_type_count; ++i) {
+        size_t name_len = strlen(query_types[i].name);
+        if(strncmp(query_str, query_types[i].name, name_len) != 0) continue;
+        if(query_str[name_len] == '\0')
+            return try_to_parse_named_query(query_types[i].name, NULL, query);
+        if(query_str[name_len] == ' ')
+            return try_to_parse_named_query(query_types[i].name, query_str + name_len + 1, query);
+    }
+
+    fprintf(stderr, "Invalid query!\n");
+    return false;
+}
+
+bool try_to_parse_named_query(char* name, char* args, query_t* query) {
+    query->has_pattern = false;
+    query->select = NULL;
+    query_type_t* query_types = NULL;
+    size_t query_type_count = get_query_types(&query_types);
+    for(size_t i = 0; i < query_type_count; ++i) {
+        if(strcmp(query_types[i].name, name) != 0) continue;
+        if(!ensure_args_present(args, name)) return false;
+        return query_types[i].parse(args, query);
+    }
+
+    fprintf(stderr, "Invalid query!\n");
+    return false;
+}
+
+bool parse_largerthan_query(char* args, query_t* query) {
+    query->value.min_size = atoi(args);
+    char normalized_args[32];
+    snprintf(normalized_args, sizeof(normalized_args), "%lld", (long long)query->value.min_size);
+    query->key = make_query_key("largerthan", normalized_args);
+    query->filter = largerthan_filter;
+    query->filter_data = &query->value.min_size;
+    return true;
+}
+
+bool largerthan_filter(file_t* file, void* min_size) {
+    return file->size > *(off_t*)min_size;
+}
+
+bool parse_namepart_query(char* args, query_t* query) {
+    query->key = make_query_key("namepart", args);
+    query->filter = namepart_filter;
+    // The key outlives the query execution, unlike `args`
+    query->filter_data = query->key + strlen("namepart ");
+    return true;
+}
+
+bool namepart_filter(file_t* file, void* namepart) {
+    return strstr(file->name, namepart) != NULL;
+}
+
+bool parse_owner_query(char* args, query_t* query) {
+    query->value.uid = atoi(args);
+    char normalized_args[32];
+    snprintf(normalized_args, sizeof(normalized_args), "%u", query->value.uid);
+    query->key = make_query_key("owner", normalized_args);
+    query->filter = owner_filter;
+    query->filter_data = &query->value.uid;
+    return true;
+}
+
+bool owner_filter(file_t* file, void* uid) {
+    return file->owner == *(uid_t*)uid;
+}
+
+// Patterns are compiled once per query, matching does not allocate
+bool parse_nameglob_query(char* args, query_t* query) {
+    if(!try_to_compile_glob(args, &query->value.pattern)) return false;
+    query->has_pattern = true;
+    query->key = make_query_key("nameglob", args);
+    query->filter = name_pattern_filter;
+    query->filter_data = &query->value.pattern;
+    return true;
+}
+
+bool parse_nameregex_query(char* args, query_t* query) {
+    if(!try_to_compile_regex(args, &query->value.pattern)) return false;
+    query->has_pattern = true;
+    query->key = make_query_key("nameregex", args);
+    query->filter = name_pattern_filter;
+    query->filter_data = &query->value.pattern;
+    return true;
+}
+
+bool name_pattern_filter(file_t* file, void* pattern) {
+    return pattern_matches(pattern, file->name);
+}
+
+// Case-insensitive queries fold their arguments once and compare them with the folded names
+// stored in the index, so they run exactly like their case-sensitive counterparts
+bool parse_inamepart_query(char* args, query_t* query) {
+    char* folded_args = fold_query_args(args);
+    query->key = make_query_key("inamepart", folded_args);
+    free(folded_args);
+    query->filter = folded_namepart_filter;
+    query->filter_data = query->key + strlen("inamepart ");
+    return true;
+}
+
+bool folded_namepart_filter(file_t* file, void* namepart) {
+    return strstr(file->folded_name, namepart) != NULL;
+}
+
+// Escapes in patterns only quote single characters, so folding the whole pattern is safe
+bool parse_inameglob_query(char* args, query_t* query) {
+    char* folded_args = fold_query_args(args);
+    bool is_compiled = try_to_compile_glob(folded_args, &query->value.pattern);
+    if(is_compiled) {
+        query->has_pattern = true;
+        query->key = make_query_key("inameglob", folded_args);
+        query->filter = folded_name_pattern_filter;
+        query->filter_data = &query->value.pattern;
+    }
+
+    free(folded_args);
+    return is_compiled;
+}
+
+bool parse_inameregex_query(char* args, query_t* query) {
+    char* folded_args = fold_query_args(args);
+    bool is_compiled = try_to_compile_regex(folded_args, &query->value.pattern);
+    if(is_compiled) {
+        query->has_pattern = true;
+        query->key = make_query_key("inameregex", folded_args);
+        query->filter = folded_name_pattern_filter;
+        query->filter_data = &query->value.pattern;
+    }
+
+    free(folded_args);
+    return is_compiled;
+}
+
+bool folded_name_pattern_filter(file_t* file, void* pattern) {
+    return pattern_matches(pattern, file->folded_name);
+}
+
+char* fold_query_args(char* args) {
+    size_t max_folded_len = MAX_FOLDED_LEN(strlen(args));
+    char* folded_args = malloc(max_folded_len + 1);
+    if(folded_args == NULL) ERR("malloc");
+    fold_case(args, folded_args, max_folded_len);
+    return folded_args;
+}
+
+bool parse_newerthan_query(char* args, query_t* query) {
+    return parse_time_bound_query("newerthan", args, true, query);
+}
+
+bool parse_olderthan_query(char* args, query_t* query) {
+    return parse_time_bound_query("olderthan", args, false, query);
+}
+
+// `args` are a timestamp optionally followed by `mtime` (default) or `ctime`
+bool parse_time_bound_query(char* cmd_name, char* args, bool is_newer, query_t* query) {
+    time_bound_t* bound = &query->value.time_bound;
+    bound->is_newer = is_newer;
+    bound->field = MODIFICATION_TIME;
+    char* field_str = strchr(args, ' ');
+    if(field_str != NULL) *field_str++ = '\0';
+    if(
+        !try_to_parse_timestamp(args, &bound->time) ||
+        (field_str != NULL && !try_to_parse_time_field(field_str, &bound->field))
+    ) {
+        fprintf(
+            stderr,
+            "Usage: %s unix_time|Ns|Nm|Nh|Nd|Nw|YYYY-MM-DD[THH:MM:SS] [mtime|ctime]\n",
+            cmd_name
+        );
+        return false;
+    }
+
+    // Relative times are resolved, so that the key stays valid for the whole generation
+    char normalized_args[48];
+    snprintf(
+        normalized_args,
+        sizeof(normalized_args),
+        "%lld %s",
+        (long long)bound->time,
+        bound->field == CHANGE_TIME ? "ctime" : "mtime"
+    );
+    query->key = make_query_key(cmd_name, normalized_args);
+    query->filter = time_bound_filter;
+    query->filter_data = bound;
+    query->select = select_by_time;
+    return true;
+}
+
+bool try_to_parse_time_field(char* str, time_field_t* field) {
+    if(strcmp(str, "mtime") == 0) *field = MODIFICATION_TIME;
+    else if(strcmp(str, "ctime") == 0) *field = CHANGE_TIME;
+    else return false;
+    return true;
+}
+
+// Accepts Unix time, time elapsed since then (e.g. `90m`) or a local date
+bool try_to_parse_timestamp(char* str, time_t* timestamp) {
+    char* end;
+    long long value = strtoll(str, &end, 10);
+    if(end != str && *end == '\0') {
+        *timestamp = value;
+        return true;
+    }
+
+    return try_to_parse_relative_time(str, timestamp) || try_to_parse_date(str, timestamp);
+}
+
+bool try_to_parse_relative_time(char* str, time_t* timestamp) {
+    static struct { char suffix; time_t seconds; } st_units[] = {
+        { 's', 1 }, { 'm', 60 }, { 'h', 3600 }, { 'd', 86400 }, { 'w', 604800 }
+    };
+
+    char* end;
+    long long value = strtoll(str, &end, 10);
+    if(end == str || value < 0 || end[0] == '\0' || end[1] != '\0') return false;
+    for(size_t i = 0; i < sizeof(st_units) / sizeof(st_units[0]); ++i) {
+        if(*end != st_units[i].suffix) continue;
+        time_t now = time(NULL);
+        if(now == -1) ERR("time");
+        *timestamp = now - value * st_units[i].seconds;
+        return true;
+    }
+
+    return false;
+}
+
+bool try_to_parse_date(char* str, time_t* timestamp) {
+    struct tm date = { .tm_isdst = -1 };
+    int date_len = 0, time_len = 0;
+    if(sscanf(str, "%4d-%2d-%2d%n", &date.tm_year, &date.tm_mon, &date.tm_mday, &date_len) != 3)
+        return false;
+    if(str[date_len] == 'T' && sscanf(
+        str + date_len, "T%2d:%2d:%2d%n", &date.tm_hour, &date.tm_min, &date.tm_sec, &time_len
+    ) != 3)
+        return false;
+    if(str[date_len + time_len] != '\0') return false;
+
+    date.tm_year -= 1900;
+    date.tm_mon -= 1;
+    *timestamp = mktime(&date);
+    return *timestamp != -1;
+}
+
+bool time_bound_filter(file_t* file, void* time_bound) {
+    time_bound_t* bound = time_bound;
+    time_t time = bound->field == CHANGE_TIME ? file->ctime : file->mtime;
+    return bound->is_newer ? time > bound->time : time < bound->time;
+}
+
+// Matching files are found by binary search in the files sorted by time
+size_t select_by_time(indexing_data_t* data, void* time_bound, size_t* file_ids) {
+    time_bound_t* bound = time_bound;
+    return time_index_select(
+        &data->time_index, &data->index, bound->field, bound->time, bound->is_newer, file_ids);
+}
+
+bool all_files_filter(file_t* file, void* data) {
+    (void)file;
+    (void)data;
+    return true;
+}
+
+char* split_scope_path(char** args) {
+    if(*args == NULL) return NULL;
+    if(strncmp(*args, "under ", strlen("under ")) == 0) {
+        char* path = *args + strlen("under ");
+        *args = NULL;
+        return path;
+    }
+
+    char* qualifier = NULL;
+    for(char* found = *args; (found = strstr(found, " under ")) != NULL; ++found)
+        qualifier = found;
+    if(qualifier == NULL) return NULL;
+    *qualifier = '\0';
+    return qualifier + strlen(" under ");
+}
+
+bool try_to_restrict_query(indexing_data_t* data, query_t* query, char* scope_path) {
+    if(!try_to_resolve_scope(data, scope_path, &query->range)) return false;
+    if(scope_path == NULL) return true;
+
+    // Ranges identify directories within a generation, just like the keys of cached results
+    char prefix[48];
+    int prefix_len =
+        snprintf(prefix, sizeof(prefix), "under %lu-%lu ", query->range.first, query->range.last);
+    size_t key_len = strlen(query->key);
+    char* key = malloc(prefix_len + key_len + 1);
+    if(key == NULL) ERR("malloc");
+    memcpy(key, prefix, prefix_len);
+    strcpy(key + prefix_len, query->key);
+    // The new key ends with the old one, so arguments stored in it are still terminated
+    char* filter_data = query->filter_data;
+    if(filter_data >= query->key && filter_data <= query->key + key_len)
+        query->filter_data = key + prefix_len + (filter_data - query->key);
+    free(query->key);
+    query->key = key;
+    return true;
+}
+
+// Queries with the same key have the same results on the same index generation
+char* make_query_key(char* cmd_name, char* normalized_args) {
+    size_t name_len = strlen(cmd_name);
+    char* key = malloc(name_len + strlen(normalized_args) + 2);
+    if(key == NULL) ERR("malloc");
+    memcpy(key, cmd_name, name_len);
+    key[name_len] = ' ';
+    strcpy(key + name_len + 1, normalized_args);
+    return key;
+}
+
+void execute_query(indexing_data_t* data, query_t* query, ordering_t* ordering) {
+    // Top files are selected with a bounded heap, the full result is never materialized
+    if(ordering != NULL && ordering->limit != 0) {
+        print_top_files(data, query, ordering);
+        return;
+    }
+
+    size_t* file_ids;
+    size_t items;
+    bool is_cached = get_query_results(data, query, &file_ids, &items);
+    if(ordering == NULL) {
+        FILE* stream = open_fileprinting_stream(data, items);
+        print_files(data, file_ids, items, stream);
+        close_filepriting_stream(data, stream);
+    }
+    else print_sorted_files(data, file_ids, items, ordering->compare);
+
+    if(!is_cached) free(file_ids);
+}
+
+// Returns true if `file_ids` are owned by the query cache, false if they have to be freed
+bool get_query_results(
+    indexing_data_t* data,
+    query_t* query,
+    size_t** file_ids,
+    size_t* files_count
+) {
+    uint64_t generation = data->index.generation;
+    if(query_cache_lookup(&data->query_cache, query->key, generation, file_ids, files_count))
+        return true;
+
+    // Selectors consider the whole index
+    size_t max_count = query->select != NULL ?
+        data->index.files_count : query->range.last - query->range.first;
+    *file_ids = malloc(max_count * sizeof(size_t));
+    if(max_count != 0 && *file_ids == NULL) ERR("malloc");
+    if(query->select != NULL) {
+        *files_count = query->select(data, query->filter_data, *file_ids);
+        *files_count = restrict_to_range(*file_ids, *files_count, &query->range);
+    }
+    else {
+        *files_count = filter_files(
+            &data->query_pool,
+            &data->index,
+            &query->range,
+            query->filter,
+            query->filter_data,
+            *file_ids
+        );
+    }
+    if(*files_count != 0) {
+        *file_ids = realloc(*file_ids, *files_count * sizeof(size_t));
+        if(*file_ids == NULL) ERR("realloc");
+    }
+
+    return query_cache_store(&data->query_cache, query->key, generation, *file_ids, *files_count);
+}
+
+// `file_ids` are sorted, so files in the range form a contiguous part of them
+size_t restrict_to_range(size_t* file_ids, size_t files_count, file_range_t* range) {
+    size_t first = find_first_id_not_below(file_ids, files_count, range->first);
+    size_t last = find_first_id_not_below(file_ids, files_count, range->last);
+    memmove(file_ids, file_ids + first, (last - first) * sizeof(size_t));
+    return last - first;
+}
+
+size_t find_first_id_not_below(size_t* file_ids, size_t files_count, size_t id) {
+    size_t low = 0, high = files_count;
+    while(low < high) {
+        size_t middle = low + (high - low) / 2;
+        if(file_ids[middle] < id) low = middle + 1;
+        else high = middle;
+    }
+
+    return low;
+}
+
+void print_sorted_files(
+    indexing_data_t* data,
+    size_t* file_ids,
+    size_t files_count,
+    heap_compare_t compare
+) {
+    file_t** files = malloc(files_count * sizeof(file_t*));
+    if(files_count != 0 && files == NULL) ERR("malloc");
+    for(size_t i = 0; i < files_count; ++i)
+        files[i] = &data->index.files[file_ids[i]];
+
+    qsort(files, files_count, sizeof(file_t*), compare);
+    print_file_pointers(data, files, files_count);
+    free(files);
+}
+
+void print_top_files(indexing_data_t* data, query_t* query, ordering_t* ordering) {
+    size_t range_len = query->range.last - query->range.first;
+    size_t capacity = ordering->limit < range_len ? ordering->limit : range_len;
+    bounded_heap_t heap;
+    bounded_heap_init(&heap, capacity, ordering->compare);
+
+    size_t* file_ids;
+    size_t items;
+    if(query_cache_lookup(
+        &data->query_cache, query->key, data->index.generation, &file_ids, &items)
+    ) {
+        for(size_t i = 0; i < items; ++i)
+            bounded_heap_push(&heap, &data->index.files[file_ids[i]]);
+    }
+    else {
+        for(size_t i = query->range.first; i < query->range.last; ++i) {
+            file_t* file = &data->index.files[i];
+            if(query->filter(file, query->filter_data)) bounded_heap_push(&heap, file);
+        }
+    }
+
+    size_t files_count;
+    file_t** files = (file_t**)bounded_heap_take_sorted(&heap, &files_count);
+    print_file_pointers(data, files, files_count);
+    free(files);
+    bounded_heap_destroy(&heap);
+}
+
+void destroy_query(query_t* query) {
+    if(query->has_pattern) destroy_pattern(&query->value.pattern);
+    free(query->key);
+    query->key = NULL;
+}
+
+// Files with equal keys keep their order from the index
+int compare_positions(const file_t* a, const file_t* b) {
+    return (a > b) - (a < b);
+}
+
+int compare_by_size_descending(const void* a, const void* b) {
+    const file_t* fa = *(file_t* const*)a;
+    const file_t* fb = *(file_t* const*)b;
+    if(fa->size != fb->size) return fa->size > fb->size ? -1 : 1;
+    return compare_positions(fa, fb);
+}
+
+int compare_by_size_ascending(const void* a, const void* b) {
+    const file_t* fa = *(file_t* const*)a;
+    const file_t* fb = *(file_t* const*)b;
+    if(fa->size != fb->size) return fa->size < fb->size ? -1 : 1;
+    return compare_positions(fa, fb);
+}
+
+int compare_by_name(const void* a, const void* b) {
+    const file_t* fa = *(file_t* const*)a;
+    const file_t* fb = *(file_t* const*)b;
+    int result = strcmp(fa->name, fb->name);
+    return result != 0 ? result : compare_positions(fa, fb);
+}
+
+int compare_by_path(const void* a, const void* b) {
+    const file_t* fa = *(file_t* const*)a;
+    const file_t* fb = *(file_t* const*)b;
+    int result = strcmp(fa->path, fb->path);
+    return result != 0 ? result : compare_positions(fa, fb);
+}
+
+FILE* open_fileprinting_stream(indexing_data_t* data, size_t items) {
+    output_t* output = &data->output;
+    if(output->stream != NULL) return output->stream;
+    if(items <= 3 || getenv("PAGER") == NULL) return stdout;
+    if(!output->defers_paging) return popen(getenv("PAGER"), "w");
+
+    if(output->page_stream == NULL) {
+        output->page_stream = open_memstream(&output->page, &output->page_len);
+        if(output->page_stream == NULL) ERR("open_memstream");
+    }
+    return output->page_stream;
+}
+
+void close_filepriting_stream(indexing_data_t* data, FILE* stream) {
+    if(stream != stdout && stream != data->output.stream && stream != data->output.page_stream)
+        pclose(stream);
+}
+
+void page_deferred_output(indexing_data_t* data) {
+    output_t* output = &data->output;
+    if(output->page_stream == NULL) return;
+    if(fclose(output->page_stream)) ERR("fclose");
+    FILE* pager = popen(getenv("PAGER"), "w");
+    if(pager == NULL) ERR("popen");
+    fwrite(output->page, 1, output->page_len, pager);
+    pclose(pager);
+    free(output->page);
+    output->page_stream = NULL;
+    output->page = NULL;
+    output->page_len = 0;
+}
+
+void print_files(indexing_data_t* data, size_t* file_ids, size_t files_count, FILE* stream) {
+    for(size_t i = 0; i < files_count; ++i)
+        print_file(data, &data->index.files[file_ids[i]], stream);
+}
+
+void print_file_pointers(indexing_data_t* data, file_t** files, size_t files_count) {
+    FILE* stream = open_fileprinting_stream(data, files_count);
+    for(size_t i = 0; i < files_count; ++i)
+        print_file(data, files[i], stream);
+    close_filepriting_stream(data, stream);
+}
+
+void print_file(indexing_data_t* data, file_t* file, FILE* stream) {
+    print_file_record(
+        &data->output, stream, file->path, file->size, data->filetypes[file->type].name);
+}
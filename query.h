@@ -0,0 +1,74 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <stdio.h>
+
+#include "index.h"
+#include "heap.h"
+#include "pattern.h"
+#include "subtree.h"
+
+typedef bool (*filter_t) (file_t* file, void* data);
+// Stores indices of matching files in `file_ids` in the index order and returns their number
+typedef size_t (*selector_t) (indexing_data_t* data, void* filter_data, size_t* file_ids);
+
+// Files whose time is later (or earlier) than `time`
+typedef struct time_bound {
+    time_t time;
+    time_field_t field;
+    bool is_newer;
+} time_bound_t;
+
+typedef struct query {
+    // Identifies the query in the query cache
+    char* key;
+    filter_t filter;
+    void* filter_data;
+    // Finds matching files without testing all of them with `filter`, it can be NULL
+    selector_t select;
+    // Only files in this range are considered, set by `try_to_restrict_query`
+    file_range_t range;
+    // Storage for parsed arguments `filter_data` can point to
+    union {
+        off_t min_size;
+        uid_t uid;
+        pattern_t pattern;
+        time_bound_t time_bound;
+    } value;
+    bool has_pattern;
+} query_t;
+
+// Order in which matching files are printed
+typedef struct ordering {
+    // Comparator of `file_t*` items
+    heap_compare_t compare;
+    // Only this many first files are printed, 0 means all of them
+    size_t limit;
+} ordering_t;
+
+// `query_str` consists of a query command and its arguments, e.g. `namepart .png`.
+// NULL means a query matching all files.
+bool try_to_parse_query(char* query_str, query_t* query);
+bool try_to_parse_named_query(char* name, char* args, query_t* query);
+// Removes the `under path` qualifier from the end of `args` (NULL if nothing is left)
+// and returns the path, NULL if there is no qualifier
+char* split_scope_path(char** args);
+// Restricts the parsed query to the contents of the directory `scope_path`,
+// or to the whole index if it is NULL. Has to be called before the query is executed.
+bool try_to_restrict_query(indexing_data_t* data, query_t* query, char* scope_path);
+// `ordering` can be NULL, then files are printed in the index order
+void execute_query(indexing_data_t* data, query_t* query, ordering_t* ordering);
+void destroy_query(query_t* query);
+
+int compare_by_size_descending(const void* a, const void* b);
+int compare_by_size_ascending(const void* a, const void* b);
+int compare_by_name(const void* a, const void* b);
+int compare_by_path(const void* a, const void* b);
+
+FILE* open_fileprinting_stream(indexing_data_t* data, size_t items);
+void close_filepriting_stream(indexing_data_t* data, FILE* stream);
+// Starts the pager for output buffered while `output.defers_paging` was set
+void page_deferred_output(indexing_data_t* data);
+void print_file(indexing_data_t* data, file_t* file, FILE* stream);
+
+#endif
@@ -0,0 +1,107 @@
+#include <string.h>
+
+#include "error.h"
+
+#include "query_cache.h"
+
+void switch_generation(query_cache_t* cache, uint64_t generation);
+size_t get_entry_memory(char* key, size_t files_count);
+void evict_least_recently_used(query_cache_t* cache);
+void remove_entry(query_cache_t* cache, size_t entry_id);
+
+void query_cache_init(query_cache_t* cache) {
+    cache->entries_count = 0;
+    cache->memory_used = 0;
+    cache->generation = 0;
+    cache->clock = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+    cache->invalidations = 0;
+}
+
+bool query_cache_lookup(
+    query_cache_t* cache,
+    char* key,
+    uint64_t generation,
+    size_t** file_ids,
+    size_t* files_count
+) {
+    switch_generation(cache, generation);
+    for(size_t i = 0; i < cache->entries_count; ++i) {
+        if(strcmp(cache->entries[i].key, key) != 0) continue;
+        cache->entries[i].last_used = ++cache->clock;
+        *file_ids = cache->entries[i].file_ids;
+        *files_count = cache->entries[i].files_count;
+        cache->hits += 1;
+        return true;
+    }
+
+    cache->misses += 1;
+    return false;
+}
+
+bool query_cache_store(
+    query_cache_t* cache,
+    char* key,
+    uint64_t generation,
+    size_t* file_ids,
+    size_t files_count
+) {
+    switch_generation(cache, generation);
+    size_t memory = get_entry_memory(key, files_count);
+    if(memory > QUERY_CACHE_MAX_MEMORY) return false;
+
+    while(cache->entries_count == QUERY_CACHE_CAPACITY ||
+        cache->memory_used + memory > QUERY_CACHE_MAX_MEMORY)
+        evict_least_recently_used(cache);
+
+    char* key_copy = strdup(key);
+    if(key_copy == NULL) ERR("strdup");
+    cache->entries[cache->entries_count++] = (cached_query_t){
+        .key = key_copy,
+        .file_ids = file_ids,
+        .files_count = files_count,
+        .last_used = ++cache->clock
+    };
+    cache->memory_used += memory;
+    return true;
+}
+
+// Results computed on an older index are no longer valid
+void switch_generation(query_cache_t* cache, uint64_t generation) {
+    if(cache->generation == generation) return;
+    if(cache->entries_count > 0) cache->invalidations += 1;
+    query_cache_clear(cache);
+    cache->generation = generation;
+}
+
+size_t get_entry_memory(char* key, size_t files_count) {
+    return sizeof(cached_query_t) + strlen(key) + 1 + files_count * sizeof(size_t);
+}
+
+void evict_least_recently_used(query_cache_t* cache) {
+    size_t oldest = 0;
+    for(size_t i = 1; i < cache->entries_count; ++i)
+        if(cache->entries[i].last_used < cache->entries[oldest].last_used) oldest = i;
+
+    remove_entry(cache, oldest);
+    cache->evictions += 1;
+}
+
+void remove_entry(query_cache_t* cache, size_t entry_id) {
+    cached_query_t* entry = &cache->entries[entry_id];
+    cache->memory_used -= get_entry_memory(entry->key, entry->files_count);
+    free(entry->key);
+    free(entry->file_ids);
+    cache->entries[entry_id] = cache->entries[--cache->entries_count];
+}
+
+void query_cache_clear(query_cache_t* cache) {
+    while(cache->entries_count > 0)
+        remove_entry(cache, cache->entries_count - 1);
+}
+
+void query_cache_destroy(query_cache_t* cache) {
+    query_cache_clear(cache);
+}
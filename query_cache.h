@@ -0,0 +1,53 @@
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define QUERY_CACHE_CAPACITY 64LU
+#define QUERY_CACHE_MAX_MEMORY (64LU * 1024LU * 1024LU)
+
+// Result of a single query: indices of the matching files in the index
+typedef struct cached_query {
+    char* key;
+    size_t* file_ids;
+    size_t files_count;
+    uint64_t last_used;
+} cached_query_t;
+
+// Bounded LRU cache of query results.
+// All entries belong to a single index generation, they are dropped when the generation changes.
+typedef struct query_cache {
+    cached_query_t entries[QUERY_CACHE_CAPACITY];
+    size_t entries_count;
+    size_t memory_used;
+    uint64_t generation;
+    uint64_t clock;
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t invalidations;
+} query_cache_t;
+
+void query_cache_init(query_cache_t* cache);
+// Returns true and sets `file_ids` (owned by the cache) if the result of the query is cached
+bool query_cache_lookup(
+    query_cache_t* cache,
+    char* key,
+    uint64_t generation,
+    size_t** file_ids,
+    size_t* files_count
+);
+// Returns true if the cache has taken ownership of `file_ids`, false if the result is too large
+bool query_cache_store(
+    query_cache_t* cache,
+    char* key,
+    uint64_t generation,
+    size_t* file_ids,
+    size_t files_count
+);
+void query_cache_clear(query_cache_t* cache);
+void query_cache_destroy(query_cache_t* cache);
+
+#endif
@@ -0,0 +1,163 @@
+#include <string.h>
+
+#include "error.h"
+
+#include "query_executor.h"
+
+// Bytes of records scanned by a single task
+#define CHUNK_BYTES (1LU << 20)
+
+typedef struct filter_job {
+    index_t* index;
+    file_range_t* range;
+    size_t chunk_len;
+    filter_t filter;
+    void* filter_data;
+    size_t* file_ids;
+    // Number of matching files of every chunk
+    size_t* chunk_matches;
+} filter_job_t;
+
+typedef struct count_job {
+    index_t* index;
+    file_range_t* range;
+    size_t chunk_len;
+    size_t filetypes_count;
+    // `filetypes_count` counters for every chunk
+    size_t* chunk_counts;
+} count_job_t;
+
+size_t get_chunk_len();
+size_t get_chunk_count(file_range_t* range, size_t chunk_len);
+file_range_t get_chunk(file_range_t* range, size_t chunk_len, size_t chunk_id);
+void filter_chunk_task(void* void_job, size_t chunk_id);
+size_t filter_chunk(
+    index_t* index,
+    file_range_t* chunk,
+    filter_t filter,
+    void* filter_data,
+    size_t* file_ids
+);
+void count_chunk_task(void* void_job, size_t chunk_id);
+void count_chunk(index_t* index, file_range_t* chunk, size_t* counts);
+
+size_t get_chunk_len() {
+    size_t chunk_len = CHUNK_BYTES / sizeof(file_t);
+    return chunk_len > 0 ? chunk_len : 1;
+}
+
+size_t get_chunk_count(file_range_t* range, size_t chunk_len) {
+    return (range->last - range->first + chunk_len - 1) / chunk_len;
+}
+
+file_range_t get_chunk(file_range_t* range, size_t chunk_len, size_t chunk_id) {
+    file_range_t chunk = { .first = range->first + chunk_id * chunk_len };
+    chunk.last = range->last - chunk.first > chunk_len ? chunk.first + chunk_len : range->last;
+    return chunk;
+}
+
+size_t filter_files(
+    thread_pool_t* pool,
+    index_t* index,
+    file_range_t* range,
+    filter_t filter,
+    void* filter_data,
+    size_t* file_ids
+) {
+    size_t chunk_len = get_chunk_len();
+    size_t chunk_count = get_chunk_count(range, chunk_len);
+    if(chunk_count <= 1) return filter_chunk(index, range, filter, filter_data, file_ids);
+
+    filter_job_t job = {
+        .index = index,
+        .range = range,
+        .chunk_len = chunk_len,
+        .filter = filter,
+        .filter_data = filter_data,
+        .file_ids = file_ids,
+        .chunk_matches = malloc(chunk_count * sizeof(size_t))
+    };
+    if(job.chunk_matches == NULL) ERR("malloc");
+    thread_pool_run(pool, chunk_count, filter_chunk_task, &job);
+
+    // Every chunk stores its matches at its own offset in the range,
+    // which is never before the end of the matches merged so far
+    size_t items = job.chunk_matches[0];
+    for(size_t i = 1; i < chunk_count; ++i) {
+        memmove(file_ids + items, file_ids + i * chunk_len, job.chunk_matches[i] * sizeof(size_t));
+        items += job.chunk_matches[i];
+    }
+
+    free(job.chunk_matches);
+    return items;
+}
+
+void filter_chunk_task(void* void_job, size_t chunk_id) {
+    filter_job_t* job = void_job;
+    file_range_t chunk = get_chunk(job->range, job->chunk_len, chunk_id);
+    job->chunk_matches[chunk_id] = filter_chunk(
+        job->index,
+        &chunk,
+        job->filter,
+        job->filter_data,
+        job->file_ids + chunk_id * job->chunk_len
+    );
+}
+
+size_t filter_chunk(
+    index_t* index,
+    file_range_t* chunk,
+    filter_t filter,
+    void* filter_data,
+    size_t* file_ids
+) {
+    size_t items = 0;
+    for(size_t i = chunk->first; i < chunk->last; ++i)
+        if(filter(&index->files[i], filter_data)) file_ids[items++] = i;
+
+    return items;
+}
+
+size_t* count_filetypes(
+    thread_pool_t* pool,
+    index_t* index,
+    file_range_t* range,
+    size_t filetypes_count
+) {
+    size_t* counts = calloc(filetypes_count, sizeof(size_t));
+    if(counts == NULL) ERR("calloc");
+    size_t chunk_len = get_chunk_len();
+    size_t chunk_count = get_chunk_count(range, chunk_len);
+    if(chunk_count <= 1) {
+        count_chunk(index, range, counts);
+        return counts;
+    }
+
+    count_job_t job = {
+        .index = index,
+        .range = range,
+        .chunk_len = chunk_len,
+        .filetypes_count = filetypes_count,
+        .chunk_counts = calloc(chunk_count * filetypes_count, sizeof(size_t))
+    };
+    if(job.chunk_counts == NULL) ERR("calloc");
+    thread_pool_run(pool, chunk_count, count_chunk_task, &job);
+
+    for(size_t i = 0; i < chunk_count; ++i)
+        for(size_t type = 0; type < filetypes_count; ++type)
+            counts[type] += job.chunk_counts[i * filetypes_count + type];
+
+    free(job.chunk_counts);
+    return counts;
+}
+
+void count_chunk_task(void* void_job, size_t chunk_id) {
+    count_job_t* job = void_job;
+    file_range_t chunk = get_chunk(job->range, job->chunk_len, chunk_id);
+    count_chunk(job->index, &chunk, job->chunk_counts + chunk_id * job->filetypes_count);
+}
+
+void count_chunk(index_t* index, file_range_t* chunk, size_t* counts) {
+    for(size_t i = chunk->first; i < chunk->last; ++i)
+        counts[index->files[i].type] += 1;
+}
@@ -0,0 +1,31 @@
+#ifndef QUERY_EXECUTOR_H
+#define QUERY_EXECUTOR_H
+
+#include <stdlib.h>
+
+#include "thread_pool.h"
+#include "query.h"
+
+// Scans split the range into chunks of records which fit in the cache and evaluate them
+// on the pool, results of chunks are merged in the index order.
+// Ranges not longer than a chunk are scanned by the calling thread.
+
+// Stores indices of files in `range` accepted by `filter` in `file_ids` in the index order
+// and returns their number. `file_ids` has to have space for the whole range.
+size_t filter_files(
+    thread_pool_t* pool,
+    index_t* index,
+    file_range_t* range,
+    filter_t filter,
+    void* filter_data,
+    size_t* file_ids
+);
+// Returns an allocated array of numbers of files of every type in `range`
+size_t* count_filetypes(
+    thread_pool_t* pool,
+    index_t* index,
+    file_range_t* range,
+    size_t filetypes_count
+);
+
+#endif
@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "error.h"
+
+#include "rebuild_scheduler.h"
+
+// Rebuilds changing more than this fraction of files are repeated sooner
+#define HIGH_CHURN 0.01
+// Rebuilds changing less than this fraction of files are repeated later
+#define LOW_CHURN 0.001
+// Indexing can take at most 1/MIN_INTERVAL_TO_DURATION of the time
+#define MIN_INTERVAL_TO_DURATION 4.0
+// Percentage of time in which some tasks were stalled on I/O over the last 10 seconds
+#define IO_PRESSURE_PATH "/proc/pressure/io"
+#define MAX_IO_PRESSURE 10.0
+
+void record_rebuild(
+    rebuild_scheduler_t* scheduler,
+    double interval,
+    double duration,
+    char* summary,
+    char* decision
+);
+int clamp_interval(rebuild_scheduler_t* scheduler, double interval);
+void reschedule(rebuild_scheduler_t* scheduler);
+bool is_rebuild_due(rebuild_scheduler_t* scheduler, time_t current_time);
+double get_io_pressure();
+
+void rebuild_scheduler_init(
+    rebuild_scheduler_t* scheduler,
+    int interval,
+    int min_interval,
+    int max_interval,
+    time_t last_rebuild_time
+) {
+    if(pthread_mutex_init(&scheduler->mx_scheduler, NULL)) ERR("pthread_mutex_init");
+    if(pthread_cond_init(&scheduler->cv_schedule_changed, NULL)) ERR("pthread_cond_init");
+    scheduler->is_enabled = interval > 0;
+    scheduler->is_stopped = false;
+    scheduler->min_interval = min_interval;
+    scheduler->max_interval = max_interval;
+    scheduler->duration_floor = 0;
+    scheduler->interval = scheduler->is_enabled ? clamp_interval(scheduler, interval) : 0;
+    scheduler->last_rebuild_time = last_rebuild_time;
+    reschedule(scheduler);
+    snprintf(scheduler->reason, MAX_REBUILD_REASON_LEN, "initial interval");
+}
+
+// The duration floor is applied after the bounds, so that rebuilds never run back to back,
+// even if they take longer than a fraction of the maximal interval
+int clamp_interval(rebuild_scheduler_t* scheduler, double interval) {
+    if(interval < scheduler->min_interval) interval = scheduler->min_interval;
+    if(interval > scheduler->max_interval) interval = scheduler->max_interval;
+    return interval < scheduler->duration_floor ? scheduler->duration_floor : interval;
+}
+
+void reschedule(rebuild_scheduler_t* scheduler) {
+    scheduler->next_rebuild_time = scheduler->last_rebuild_time + scheduler->interval;
+    pthread_cond_broadcast(&scheduler->cv_schedule_changed);
+}
+
+bool rebuild_scheduler_wait(rebuild_scheduler_t* scheduler) {
+    pthread_mutex_lock(&scheduler->mx_scheduler);
+    for(;;) {
+        time_t current_time = time(NULL);
+        if(current_time == -1) ERR("time");
+        if(scheduler->is_stopped) break;
+        if(is_rebuild_due(scheduler, current_time)) {
+            // Rebuilds which take longer than the interval are not started again
+            scheduler->next_rebuild_time = current_time + scheduler->interval;
+            pthread_mutex_unlock(&scheduler->mx_scheduler);
+            return true;
+        }
+
+        if(!scheduler->is_enabled) {
+            pthread_cond_wait(&scheduler->cv_schedule_changed, &scheduler->mx_scheduler);
+            continue;
+        }
+
+        struct timespec wakeup = { .tv_sec = scheduler->next_rebuild_time, .tv_nsec = 0 };
+        pthread_cond_timedwait(
+            &scheduler->cv_schedule_changed, &scheduler->mx_scheduler, &wakeup);
+    }
+
+    pthread_mutex_unlock(&scheduler->mx_scheduler);
+    return false;
+}
+
+// A due rebuild is postponed while the system is under I/O pressure
+bool is_rebuild_due(rebuild_scheduler_t* scheduler, time_t current_time) {
+    if(!scheduler->is_enabled || current_time < scheduler->next_rebuild_time) return false;
+    double io_pressure = get_io_pressure();
+    if(io_pressure <= MAX_IO_PRESSURE) return true;
+
+    scheduler->interval = clamp_interval(scheduler, 2.0 * scheduler->interval);
+    scheduler->next_rebuild_time = current_time + scheduler->interval;
+    snprintf(
+        scheduler->reason,
+        MAX_REBUILD_REASON_LEN,
+        "I/O pressure %.1lf%% exceeds %.1lf%%, rebuild postponed and interval doubled",
+        io_pressure,
+        MAX_IO_PRESSURE
+    );
+    return false;
+}
+
+// Returns 0 if pressure stall information is not available
+double get_io_pressure() {
+    FILE* file = fopen(IO_PRESSURE_PATH, "r");
+    if(file == NULL) return 0.0;
+    double pressure;
+    if(fscanf(file, "some avg10=%lf", &pressure) != 1) pressure = 0.0;
+    fclose(file);
+    return pressure;
+}
+
+void rebuild_scheduler_report(
+    rebuild_scheduler_t* scheduler,
+    size_t changed_count,
+    size_t files_count,
+    double duration
+) {
+    double churn = files_count == 0 ? 0.0 : (double)changed_count / files_count;
+    double interval = scheduler->interval;
+    char* decision = "interval kept";
+    if(churn > HIGH_CHURN) {
+        interval /= 2.0;
+        decision = "interval halved";
+    }
+    else if(churn < LOW_CHURN) {
+        interval *= 2.0;
+        decision = "interval doubled";
+    }
+
+    char summary[MAX_REBUILD_REASON_LEN];
+    snprintf(
+        summary,
+        MAX_REBUILD_REASON_LEN,
+        "%lu of %lu files (%.2lf%%) changed in the last rebuild, which took %.1lf s",
+        changed_count,
+        files_count,
+        100.0 * churn,
+        duration
+    );
+    pthread_mutex_lock(&scheduler->mx_scheduler);
+    record_rebuild(scheduler, interval, duration, summary, decision);
+    pthread_mutex_unlock(&scheduler->mx_scheduler);
+}
+
+void rebuild_scheduler_report_first_build(
+    rebuild_scheduler_t* scheduler,
+    size_t files_count,
+    double duration
+) {
+    char summary[MAX_REBUILD_REASON_LEN];
+    snprintf(
+        summary,
+        MAX_REBUILD_REASON_LEN,
+        "first index of %lu files built in %.1lf s",
+        files_count,
+        duration
+    );
+    pthread_mutex_lock(&scheduler->mx_scheduler);
+    record_rebuild(scheduler, scheduler->interval, duration, summary, "interval kept");
+    pthread_mutex_unlock(&scheduler->mx_scheduler);
+}
+
+// Has to be called with the scheduler locked
+void record_rebuild(
+    rebuild_scheduler_t* scheduler,
+    double interval,
+    double duration,
+    char* summary,
+    char* decision
+) {
+    scheduler->last_rebuild_time = time(NULL);
+    if(scheduler->last_rebuild_time == -1) ERR("time");
+    if(!scheduler->is_enabled) return;
+
+    scheduler->duration_floor = MIN_INTERVAL_TO_DURATION * duration;
+    scheduler->interval = clamp_interval(scheduler, interval);
+    if(scheduler->interval == scheduler->duration_floor && scheduler->interval != (int)interval)
+        decision = "interval bounded by the duration of rebuilds";
+    snprintf(scheduler->reason, MAX_REBUILD_REASON_LEN, "%s; %s", summary, decision);
+    reschedule(scheduler);
+}
+
+void rebuild_scheduler_set_interval(rebuild_scheduler_t* scheduler, int interval, char* reason) {
+    pthread_mutex_lock(&scheduler->mx_scheduler);
+    if(scheduler->is_enabled) {
+        scheduler->interval = clamp_interval(scheduler, interval);
+        snprintf(scheduler->reason, MAX_REBUILD_REASON_LEN, "%s", reason);
+        reschedule(scheduler);
+    }
+    pthread_mutex_unlock(&scheduler->mx_scheduler);
+}
+
+void rebuild_scheduler_rebuild_now(rebuild_scheduler_t* scheduler) {
+    pthread_mutex_lock(&scheduler->mx_scheduler);
+    if(scheduler->is_enabled) {
+        scheduler->next_rebuild_time = 0;
+        pthread_cond_broadcast(&scheduler->cv_schedule_changed);
+    }
+    pthread_mutex_unlock(&scheduler->mx_scheduler);
+}
+
+void rebuild_scheduler_get_schedule(
+    rebuild_scheduler_t* scheduler,
+    int* interval,
+    time_t* next_rebuild_time,
+    char* reason
+) {
+    pthread_mutex_lock(&scheduler->mx_scheduler);
+    *interval = scheduler->is_enabled ? scheduler->interval : 0;
+    *next_rebuild_time = scheduler->next_rebuild_time;
+    strcpy(reason, scheduler->reason);
+    pthread_mutex_unlock(&scheduler->mx_scheduler);
+}
+
+void rebuild_scheduler_stop(rebuild_scheduler_t* scheduler) {
+    pthread_mutex_lock(&scheduler->mx_scheduler);
+    scheduler->is_stopped = true;
+    pthread_cond_broadcast(&scheduler->cv_schedule_changed);
+    pthread_mutex_unlock(&scheduler->mx_scheduler);
+}
+
+void rebuild_scheduler_destroy(rebuild_scheduler_t* scheduler) {
+    pthread_mutex_destroy(&scheduler->mx_scheduler);
+    pthread_cond_destroy(&scheduler->cv_schedule_changed);
+}
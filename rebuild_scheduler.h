@@ -0,0 +1,70 @@
+#ifndef REBUILD_SCHEDULER_H
+#define REBUILD_SCHEDULER_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+
+#define MAX_REBUILD_REASON_LEN 160
+
+// Decides when the index is rebuilt periodically.
+// The interval between rebuilds is halved when a rebuild changes many files and doubled
+// when it changes few of them, it is never shorter than a few durations of a rebuild.
+// Rebuilds are postponed while the system is under I/O pressure.
+typedef struct rebuild_scheduler {
+    pthread_mutex_t mx_scheduler;
+    // Signalled when the schedule changes
+    pthread_cond_t cv_schedule_changed;
+    bool is_enabled;
+    bool is_stopped;
+    int interval;
+    int min_interval;
+    int max_interval;
+    // Shortest interval allowed by the duration of the last rebuild, it overrides `max_interval`
+    int duration_floor;
+    time_t last_rebuild_time;
+    // Time the next rebuild is due
+    time_t next_rebuild_time;
+    // Explanation of the current interval
+    char reason[MAX_REBUILD_REASON_LEN];
+} rebuild_scheduler_t;
+
+// Periodic rebuilds are disabled if `interval` is not positive
+void rebuild_scheduler_init(
+    rebuild_scheduler_t* scheduler,
+    int interval,
+    int min_interval,
+    int max_interval,
+    time_t last_rebuild_time
+);
+// Blocks until the next rebuild is due, returns false once the scheduler has been stopped
+bool rebuild_scheduler_wait(rebuild_scheduler_t* scheduler);
+// Adapts the interval to the results of a completed rebuild
+void rebuild_scheduler_report(
+    rebuild_scheduler_t* scheduler,
+    size_t changed_count,
+    size_t files_count,
+    double duration
+);
+// Records a rebuild which had no complete index to compare with,
+// only the duration floor is applied to the interval
+void rebuild_scheduler_report_first_build(
+    rebuild_scheduler_t* scheduler,
+    size_t files_count,
+    double duration
+);
+// Sets a new interval, clamped to the bounds and the duration floor, and reschedules the next rebuild
+void rebuild_scheduler_set_interval(rebuild_scheduler_t* scheduler, int interval, char* reason);
+void rebuild_scheduler_rebuild_now(rebuild_scheduler_t* scheduler);
+// `reason` has to have space for MAX_REBUILD_REASON_LEN characters
+void rebuild_scheduler_get_schedule(
+    rebuild_scheduler_t* scheduler,
+    int* interval,
+    time_t* next_rebuild_time,
+    char* reason
+);
+void rebuild_scheduler_stop(rebuild_scheduler_t* scheduler);
+void rebuild_scheduler_destroy(rebuild_scheduler_t* scheduler);
+
+#endif
@@ -0,0 +1,95 @@
+#include <string.h>
+
+#include "error.h"
+#include "index_builder.h"
+
+#include "rollup.h"
+
+// Directories of the index are nested at most this deep, a path has to contain a `/` per level
+#define MAX_DIRECTORY_DEPTH (MAX_FILEPATH_LEN / 2 + 1)
+
+void add_file_to_rollup(directory_rollup_t* rollup, file_t* file);
+void add_rollup(directory_rollup_t* rollup, directory_rollup_t* other);
+int compare_path_with_indexed_file(const void* path, const void* file);
+
+// Every directory is directly followed by its contents, so the directories being visited
+// form a stack. A directory is complete once a file outside of it is reached,
+// then its totals are added to its parent and the end of its contents is known.
+directory_rollup_t compute_directory_rollups(index_t* index) {
+    file_t** open_dirs = malloc(MAX_DIRECTORY_DEPTH * sizeof(file_t*));
+    if(open_dirs == NULL) ERR("malloc");
+    size_t open_count = 0;
+    // Files outside of all open directories belong to the indexed root directory
+    directory_rollup_t* root_rollup = &index->root_rollup;
+    directory_rollup_t* parent_rollup;
+    memset(root_rollup, 0, sizeof(directory_rollup_t));
+
+    for(size_t i = 0; i < index->files_count; ++i) {
+        file_t* file = &index->files[i];
+        while(open_count > 0) {
+            file_t* dir = open_dirs[open_count - 1];
+            if(is_in_directory(file->path, dir->path, strlen(dir->path))) break;
+            dir->subtree_end = i;
+            --open_count;
+            parent_rollup = open_count > 0 ? &open_dirs[open_count - 1]->rollup : root_rollup;
+            add_rollup(parent_rollup, &dir->rollup);
+        }
+
+        parent_rollup = open_count > 0 ? &open_dirs[open_count - 1]->rollup : root_rollup;
+        add_file_to_rollup(parent_rollup, file);
+        file->subtree_end = i + 1;
+        if(file->type != FILETYPE_DIRECTORY) continue;
+        memset(&file->rollup, 0, sizeof(directory_rollup_t));
+        if(open_count < MAX_DIRECTORY_DEPTH) open_dirs[open_count++] = file;
+    }
+
+    for(; open_count > 0; --open_count) {
+        open_dirs[open_count - 1]->subtree_end = index->files_count;
+        add_rollup(
+            open_count > 1 ? &open_dirs[open_count - 2]->rollup : root_rollup,
+            &open_dirs[open_count - 1]->rollup
+        );
+    }
+    free(open_dirs);
+    return *root_rollup;
+}
+
+void add_file_to_rollup(directory_rollup_t* rollup, file_t* file) {
+    if(file->type != FILETYPE_DIRECTORY) rollup->total_size += file->size;
+    rollup->type_counts[file->type] += 1;
+}
+
+void add_rollup(directory_rollup_t* rollup, directory_rollup_t* other) {
+    rollup->total_size += other->total_size;
+    for(size_t i = 0; i < MAX_FILETYPES; ++i) rollup->type_counts[i] += other->type_counts[i];
+}
+
+file_t* find_indexed_directory(index_t* index, char* path) {
+    file_t* dir = bsearch(
+        path,
+        index->files,
+        index->files_count,
+        sizeof(file_t),
+        compare_path_with_indexed_file
+    );
+    return dir != NULL && dir->type == FILETYPE_DIRECTORY ? dir : NULL;
+}
+
+int compare_path_with_indexed_file(const void* path, const void* file) {
+    return compare_index_paths(path, ((const file_t*)file)->path);
+}
+
+directory_rollup_t sum_top_level_rollups(index_t* index) {
+    directory_rollup_t rollup;
+    memset(&rollup, 0, sizeof(directory_rollup_t));
+    for(size_t i = 0; i < index->files_count; i = index->files[i].subtree_end) {
+        file_t* file = &index->files[i];
+        add_file_to_rollup(&rollup, file);
+        if(file->type == FILETYPE_DIRECTORY) add_rollup(&rollup, &file->rollup);
+    }
+    return rollup;
+}
+
+bool is_in_directory(char* path, char* dir_path, size_t dir_path_len) {
+    return strncmp(path, dir_path, dir_path_len) == 0 && path[dir_path_len] == '/';
+}
@@ -0,0 +1,19 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stdbool.h>
+
+#include "index.h"
+
+// Fills in rollups and ends of contents of all directories of an index
+// ordered by `compare_index_paths`, returns the totals of the indexed root directory
+directory_rollup_t compute_directory_rollups(index_t* index);
+// Returns the directory with the given absolute path, NULL if it is not in the index
+file_t* find_indexed_directory(index_t* index, char* path);
+// Totals of the indexed root directory of an index with computed rollups.
+// Only its direct contents are visited, subdirectories are skipped using their rollups.
+directory_rollup_t sum_top_level_rollups(index_t* index);
+// True if `path` is a path of a file somewhere below the directory `dir_path`
+bool is_in_directory(char* path, char* dir_path, size_t dir_path_len);
+
+#endif
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "error.h"
+#include "index.h"
+#include "file_io.h"
+
+#include "shared_index.h"
+
+#define SHARED_INDEX_MAGIC "MWSHARED"
+#define SHARED_INDEX_PREFIX "/maulwurf."
+// Longest object name: prefix, name, dot and a 64-bit generation
+#define MAX_SHARED_OBJECT_NAME_LEN (sizeof(SHARED_INDEX_PREFIX) + MAX_SHARED_INDEX_NAME_LEN + 22)
+// Times the number of the latest generation is read again when its object has been unlinked
+#define MAX_MAPPING_ATTEMPTS 16
+
+void get_header_object_name(shared_index_t* shared, char* object_name);
+void get_generation_object_name(shared_index_t* shared, uint64_t generation, char* object_name);
+void unlink_generation(shared_index_t* shared, uint64_t generation);
+void orphan_previous_header(char* object_name);
+shared_index_header_t* map_header(int object_desc, int protection);
+void unmap_header(shared_index_header_t* header);
+shared_index_header_t* open_client_header(shared_index_t* shared);
+bool is_header_complete(shared_index_header_t* header);
+bool is_header_orphaned(shared_index_header_t* header);
+bool try_to_reattach_shared_index(shared_index_t* shared);
+
+void shared_index_init(shared_index_t* shared) {
+    shared->role = SHARED_INDEX_NONE;
+    shared->name[0] = '\0';
+    shared->header = NULL;
+    shared->generation = 0;
+    shared->root_path[0] = '\0';
+}
+
+// Names become parts of names of shared memory objects, which cannot contain slashes
+bool is_shared_index_name_valid(char* name) {
+    size_t name_len = strlen(name);
+    return name_len > 0 && name_len <= MAX_SHARED_INDEX_NAME_LEN && strchr(name, '/') == NULL;
+}
+
+void get_header_object_name(shared_index_t* shared, char* object_name) {
+    snprintf(object_name, MAX_SHARED_OBJECT_NAME_LEN, SHARED_INDEX_PREFIX "%s", shared->name);
+}
+
+void get_generation_object_name(shared_index_t* shared, uint64_t generation, char* object_name) {
+    snprintf(
+        object_name,
+        MAX_SHARED_OBJECT_NAME_LEN,
+        SHARED_INDEX_PREFIX "%s.%lu",
+        shared->name,
+        generation
+    );
+}
+
+void shared_index_create(shared_index_t* shared, char* name, char* dir_path) {
+    shared->role = SHARED_INDEX_PUBLISHER;
+    strcpy(shared->name, name);
+    char object_name[MAX_SHARED_OBJECT_NAME_LEN];
+    get_header_object_name(shared, object_name);
+    // Clients of a previous publisher keep their header, it is not truncated under them,
+    // but they are told to attach to the new one
+    orphan_previous_header(object_name);
+    if(shm_unlink(object_name) && errno != ENOENT) ERR("shm_unlink");
+    int object_desc = shm_open(object_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if(object_desc < 0) ERR("shm_open");
+    if(ftruncate(object_desc, sizeof(shared_index_header_t))) ERR("ftruncate");
+    shared->header = map_header(object_desc, PROT_READ | PROT_WRITE);
+    if(close(object_desc)) ERR("close");
+
+    char* root_path = realpath(dir_path, NULL);
+    if(root_path == NULL) ERR("realpath");
+    snprintf(shared->root_path, SHARED_INDEX_ROOT_LEN, "%s", root_path);
+    strcpy(shared->header->root_path, shared->root_path);
+    free(root_path);
+    shared->header->publisher_pid = getpid();
+    atomic_store_explicit(&shared->header->generation, 0, memory_order_relaxed);
+    atomic_store_explicit(&shared->header->is_orphaned, false, memory_order_relaxed);
+    // The magic number is written last, it marks a complete header
+    atomic_thread_fence(memory_order_release);
+    memcpy(shared->header->magic, SHARED_INDEX_MAGIC, sizeof(shared->header->magic));
+}
+
+// Headers of other versions have a different size and are left alone
+void orphan_previous_header(char* object_name) {
+    int object_desc = shm_open(object_name, O_RDWR, 0);
+    if(object_desc < 0) {
+        if(errno == ENOENT) return;
+        ERR("shm_open");
+    }
+
+    struct stat filestat;
+    if(fstat(object_desc, &filestat)) ERR("fstat");
+    if((size_t)filestat.st_size == sizeof(shared_index_header_t)) {
+        shared_index_header_t* header = map_header(object_desc, PROT_READ | PROT_WRITE);
+        atomic_store_explicit(&header->is_orphaned, true, memory_order_release);
+        unmap_header(header);
+    }
+    if(close(object_desc)) ERR("close");
+}
+
+shared_index_header_t* map_header(int object_desc, int protection) {
+    shared_index_header_t* header =
+        mmap(NULL, sizeof(shared_index_header_t), protection, MAP_SHARED, object_desc, 0);
+    if(header == MAP_FAILED) ERR("mmap");
+    return header;
+}
+
+void unmap_header(shared_index_header_t* header) {
+    if(munmap(header, sizeof(shared_index_header_t))) ERR("munmap");
+}
+
+// The new generation is complete before its number is stored, so clients never map it partially.
+// Clients still using the previous generation keep their mapping after it is unlinked.
+void shared_index_publish(shared_index_t* shared, index_t* index) {
+    uint64_t generation = shared->generation + 1;
+    char object_name[MAX_SHARED_OBJECT_NAME_LEN];
+    get_generation_object_name(shared, generation, object_name);
+    // An object left by a crashed publisher can still be mapped by clients, it is not truncated
+    unlink_generation(shared, generation);
+    int object_desc = shm_open(object_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if(object_desc < 0) ERR("shm_open");
+    bool is_written = try_to_write_index_to_desc(object_desc, index);
+    // The publisher serves the generation instead of keeping a second copy of the records,
+    // if it cannot be mapped the records are kept in memory
+    if(is_written && index->mapping == NULL) try_to_map_written_index(object_desc, index);
+    if(close(object_desc)) ERR("close");
+    // E.g. when the shared memory is full, clients keep the previous generation
+    if(!is_written) {
+        fprintf(stderr, "Generation %lu of the shared index cannot be written!\n", generation);
+        unlink_generation(shared, generation);
+        return;
+    }
+
+    atomic_store_explicit(&shared->header->generation, generation, memory_order_release);
+    if(shared->generation != 0) unlink_generation(shared, shared->generation);
+    shared->generation = generation;
+}
+
+void unlink_generation(shared_index_t* shared, uint64_t generation) {
+    char object_name[MAX_SHARED_OBJECT_NAME_LEN];
+    get_generation_object_name(shared, generation, object_name);
+    if(shm_unlink(object_name) && errno != ENOENT) ERR("shm_unlink");
+}
+
+bool try_to_attach_shared_index(shared_index_t* shared, char* name) {
+    shared->role = SHARED_INDEX_CLIENT;
+    strcpy(shared->name, name);
+    shared->header = open_client_header(shared);
+    if(shared->header == NULL) {
+        fprintf(stderr, "Shared index %s does not exist!\n", name);
+        shared_index_init(shared);
+        return false;
+    }
+    if(!is_header_complete(shared->header)) {
+        fprintf(stderr, "Shared index %s is invalid!\n", name);
+        shared_index_destroy(shared);
+        return false;
+    }
+
+    strcpy(shared->root_path, shared->header->root_path);
+    return true;
+}
+
+// Returns NULL if the header does not exist
+shared_index_header_t* open_client_header(shared_index_t* shared) {
+    char object_name[MAX_SHARED_OBJECT_NAME_LEN];
+    get_header_object_name(shared, object_name);
+    int object_desc = shm_open(object_name, O_RDONLY, 0);
+    if(object_desc < 0) {
+        if(errno != ENOENT) ERR("shm_open");
+        return NULL;
+    }
+
+    shared_index_header_t* header = map_header(object_desc, PROT_READ);
+    if(close(object_desc)) ERR("close");
+    return header;
+}
+
+bool is_header_complete(shared_index_header_t* header) {
+    bool is_complete = memcmp(header->magic, SHARED_INDEX_MAGIC, sizeof(header->magic)) == 0;
+    atomic_thread_fence(memory_order_acquire);
+    return is_complete;
+}
+
+bool is_header_orphaned(shared_index_header_t* header) {
+    if(atomic_load_explicit(&header->is_orphaned, memory_order_acquire)) return true;
+    return kill(header->publisher_pid, 0) && errno == ESRCH;
+}
+
+// Generation numbers of the new header start again, so any of them is newer than the mapped one
+bool try_to_reattach_shared_index(shared_index_t* shared) {
+    shared_index_header_t* header = open_client_header(shared);
+    if(header != NULL && (!is_header_complete(header) || is_header_orphaned(header))) {
+        unmap_header(header);
+        header = NULL;
+    }
+    if(header == NULL) {
+        fprintf(
+            stderr,
+            "Shared index %s is no longer published, results may be outdated!\n",
+            shared->name
+        );
+        return false;
+    }
+
+    unmap_header(shared->header);
+    shared->header = header;
+    shared->generation = 0;
+    strcpy(shared->root_path, header->root_path);
+    return true;
+}
+
+// The publisher can unlink a generation between reading its number and opening it,
+// then the number is read again, but only a few times
+bool try_to_map_latest_generation(shared_index_t* shared, index_t* index) {
+    for(size_t attempt = 0; attempt < MAX_MAPPING_ATTEMPTS; ++attempt) {
+        if(is_header_orphaned(shared->header) && !try_to_reattach_shared_index(shared))
+            return false;
+        uint64_t generation =
+            atomic_load_explicit(&shared->header->generation, memory_order_acquire);
+        if(generation == 0 || generation == shared->generation) return false;
+
+        char object_name[MAX_SHARED_OBJECT_NAME_LEN];
+        get_generation_object_name(shared, generation, object_name);
+        int object_desc = shm_open(object_name, O_RDONLY, 0);
+        if(object_desc < 0) {
+            if(errno == ENOENT) continue;
+            ERR("shm_open");
+        }
+
+        bool is_mapped = try_to_map_read_only_index(object_desc, index);
+        if(close(object_desc)) ERR("close");
+        if(!is_mapped) {
+            fprintf(stderr, "Generation %lu of the shared index is invalid!\n", generation);
+            return false;
+        }
+
+        shared->generation = generation;
+        return true;
+    }
+
+    fprintf(
+        stderr,
+        "Latest generation of shared index %s cannot be opened, results may be outdated!\n",
+        shared->name
+    );
+    return false;
+}
+
+void shared_index_destroy(shared_index_t* shared) {
+    if(shared->role == SHARED_INDEX_PUBLISHER) {
+        // Clients keep serving the generation they have already mapped until a new publisher starts
+        atomic_store_explicit(&shared->header->is_orphaned, true, memory_order_release);
+        if(shared->generation != 0) unlink_generation(shared, shared->generation);
+        char object_name[MAX_SHARED_OBJECT_NAME_LEN];
+        get_header_object_name(shared, object_name);
+        if(shm_unlink(object_name) && errno != ENOENT) ERR("shm_unlink");
+    }
+
+    if(shared->header != NULL) unmap_header(shared->header);
+    shared_index_init(shared);
+}
@@ -0,0 +1,65 @@
+#ifndef SHARED_INDEX_H
+#define SHARED_INDEX_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+
+#define MAX_SHARED_INDEX_NAME_LEN 200LU
+#define SHARED_INDEX_ROOT_LEN 1025LU
+
+// Header of the shared memory object `/maulwurf.<name>`.
+// Every generation is published as a separate object `/maulwurf.<name>.<generation>`
+// with the layout of an index file. Records refer to each other only by their positions,
+// so they can be mapped at any address.
+typedef struct shared_index_header {
+    char magic[8];
+    // Latest published generation, 0 if there is none
+    _Atomic uint64_t generation;
+    // Set when the publisher exits or another publisher replaces the header
+    _Atomic bool is_orphaned;
+    // Detects publishers which have crashed without orphaning the header
+    pid_t publisher_pid;
+    // Resolved path of the indexed directory
+    char root_path[SHARED_INDEX_ROOT_LEN];
+} shared_index_header_t;
+
+typedef enum shared_index_role {
+    SHARED_INDEX_NONE,
+    // Builds indices and publishes every generation
+    SHARED_INDEX_PUBLISHER,
+    // Only maps generations published by another process
+    SHARED_INDEX_CLIENT
+} shared_index_role_t;
+
+typedef struct shared_index {
+    shared_index_role_t role;
+    char name[MAX_SHARED_INDEX_NAME_LEN + 1];
+    shared_index_header_t* header;
+    // Generation published or mapped by this process, 0 if there is none
+    uint64_t generation;
+    // Copied from the header, which is replaced when clients reattach
+    char root_path[SHARED_INDEX_ROOT_LEN];
+} shared_index_t;
+
+struct index;
+
+void shared_index_init(shared_index_t* shared);
+bool is_shared_index_name_valid(char* name);
+// Creates the header of a new shared index, replacing any previous one with the same name
+void shared_index_create(shared_index_t* shared, char* name, char* dir_path);
+// Copies records of the index into a new generation and switches clients to it.
+// If the generation cannot be written completely, clients keep the previous one.
+void shared_index_publish(shared_index_t* shared, struct index* index);
+// Returns false and prints the reason if there is no shared index with that name
+bool try_to_attach_shared_index(shared_index_t* shared, char* name);
+// If a newer generation has been published, maps it read-only into `index` and returns true.
+// Clients of an orphaned header attach to the header of a new publisher first,
+// if there is none, the reason is printed and the mapped generation stays in use.
+bool try_to_map_latest_generation(shared_index_t* shared, struct index* index);
+// Publishers remove the shared index, clients only detach from it
+void shared_index_destroy(shared_index_t* shared);
+
+#endif
@@ -0,0 +1,120 @@
+#include <string.h>
+
+#include "error.h"
+#include "file_io.h"
+#include "index_builder.h"
+
+#include "signature_cache.h"
+
+#define STARTING_REJECTS_CAPACITY 64LU
+
+bool lookup_previous_index(signature_cache_t* cache, char* path, file_t* file, size_t* type);
+bool lookup_previous_rejects(signature_cache_t* cache, file_t* file);
+int compare_path_with_file(const void* path, const void* file);
+int compare_rejects(const void* a, const void* b);
+
+void signature_cache_init(signature_cache_t* cache, index_t* previous_index, char* rejects_path) {
+    cache->previous_index = previous_index;
+    cache->previous_rejects =
+        load_rejected_files_from_file(rejects_path, &cache->previous_rejects_count);
+    if(pthread_mutex_init(&cache->mx_rejects, NULL)) ERR("pthread_mutex_init");
+    cache->rejects_count = 0;
+    cache->rejects_capacity = STARTING_REJECTS_CAPACITY;
+    cache->rejects = malloc(cache->rejects_capacity * sizeof(rejected_file_t));
+    if(cache->rejects == NULL) ERR("malloc");
+}
+
+bool signature_cache_lookup(signature_cache_t* cache, char* path, file_t* file, size_t* type) {
+    if(lookup_previous_index(cache, path, file, type)) return true;
+    if(!lookup_previous_rejects(cache, file)) return false;
+    *type = FILETYPE_INVALID;
+    return true;
+}
+
+// The previous index is ordered by path, so no additional lookup structure is needed
+bool lookup_previous_index(signature_cache_t* cache, char* path, file_t* file, size_t* type) {
+    // bsearch must not be given a NULL array, which an empty index can have
+    if(cache->previous_index == NULL || cache->previous_index->files_count == 0) return false;
+    file_t* match = bsearch(
+        path,
+        cache->previous_index->files,
+        cache->previous_index->files_count,
+        sizeof(file_t),
+        compare_path_with_file
+    );
+    if(
+        match == NULL ||
+        match->type == FILETYPE_DIRECTORY ||
+        match->device != file->device ||
+        match->inode != file->inode ||
+        match->size != file->size ||
+        match->mtime != file->mtime
+    )
+        return false;
+
+    *type = match->type;
+    return true;
+}
+
+bool lookup_previous_rejects(signature_cache_t* cache, file_t* file) {
+    if(cache->previous_rejects_count == 0) return false;
+    rejected_file_t key = {
+        .device = file->device,
+        .inode = file->inode,
+        .size = file->size,
+        .mtime = file->mtime
+    };
+    return bsearch(
+        &key,
+        cache->previous_rejects,
+        cache->previous_rejects_count,
+        sizeof(rejected_file_t),
+        compare_rejects
+    ) != NULL;
+}
+
+int compare_path_with_file(const void* path, const void* file) {
+    return compare_index_paths(path, ((const file_t*)file)->path);
+}
+
+// Rejects are ordered by all of their fields, so a match means that the file has not changed
+int compare_rejects(const void* a, const void* b) {
+    const rejected_file_t* ra = a;
+    const rejected_file_t* rb = b;
+    if(ra->device != rb->device) return ra->device < rb->device ? -1 : 1;
+    if(ra->inode != rb->inode) return ra->inode < rb->inode ? -1 : 1;
+    if(ra->size != rb->size) return ra->size < rb->size ? -1 : 1;
+    if(ra->mtime != rb->mtime) return ra->mtime < rb->mtime ? -1 : 1;
+    return 0;
+}
+
+void signature_cache_add_reject(signature_cache_t* cache, file_t* file) {
+    pthread_mutex_lock(&cache->mx_rejects);
+    if(cache->rejects_count == cache->rejects_capacity) {
+        cache->rejects_capacity *= 2;
+        cache->rejects =
+            realloc(cache->rejects, cache->rejects_capacity * sizeof(rejected_file_t));
+        if(cache->rejects == NULL) ERR("realloc");
+    }
+
+    cache->rejects[cache->rejects_count++] = (rejected_file_t){
+        .device = file->device,
+        .inode = file->inode,
+        .size = file->size,
+        .mtime = file->mtime
+    };
+    pthread_mutex_unlock(&cache->mx_rejects);
+}
+
+void signature_cache_save(signature_cache_t* cache, char* rejects_path) {
+    qsort(cache->rejects, cache->rejects_count, sizeof(rejected_file_t), compare_rejects);
+    save_rejected_files_to_file(rejects_path, cache->rejects, cache->rejects_count);
+}
+
+void signature_cache_destroy(signature_cache_t* cache) {
+    pthread_mutex_destroy(&cache->mx_rejects);
+    free(cache->previous_rejects);
+    free(cache->rejects);
+    cache->previous_rejects = NULL;
+    cache->rejects = NULL;
+}
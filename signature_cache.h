@@ -0,0 +1,47 @@
+#ifndef SIGNATURE_CACHE_H
+#define SIGNATURE_CACHE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "index.h"
+
+// Regular file whose signature does not match any file type
+typedef struct rejected_file {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    time_t mtime;
+} rejected_file_t;
+
+// Types of files classified by the previous indexing.
+// A file whose device, inode, size and modification time have not changed has the same type,
+// so its signature does not have to be read again.
+typedef struct signature_cache {
+    // Files are looked up by path, NULL if there is no previous index
+    index_t* previous_index;
+    // Sorted by device and inode
+    rejected_file_t* previous_rejects;
+    size_t previous_rejects_count;
+    // Files rejected by the current indexing
+    pthread_mutex_t mx_rejects;
+    rejected_file_t* rejects;
+    size_t rejects_count;
+    size_t rejects_capacity;
+} signature_cache_t;
+
+// `previous_index` has to be sorted by `compare_index_paths` and must not change
+// until the cache is destroyed, it can be NULL
+void signature_cache_init(signature_cache_t* cache, index_t* previous_index, char* rejects_path);
+// `file` has to have stat data filled in.
+// Returns true and sets `type` if the type of the file is known,
+// it is FILETYPE_INVALID for rejected files.
+bool signature_cache_lookup(signature_cache_t* cache, char* path, file_t* file, size_t* type);
+void signature_cache_add_reject(signature_cache_t* cache, file_t* file);
+// Stores files rejected by the current indexing for the next one
+void signature_cache_save(signature_cache_t* cache, char* rejects_path);
+void signature_cache_destroy(signature_cache_t* cache);
+
+#endif
@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "error.h"
+#include "rollup.h"
+
+#include "subtree.h"
+
+file_range_t get_whole_index_range(index_t* index) {
+    return (file_range_t){ .first = 0, .last = index->files_count };
+}
+
+bool try_to_find_subtree(indexing_data_t* data, char* path, file_range_t* range, file_t** dir) {
+    char* root_path = realpath(data->dir_path, NULL);
+    bool is_root = root_path != NULL && strcmp(path, root_path) == 0;
+    free(root_path);
+    if(is_root) {
+        *range = get_whole_index_range(&data->index);
+        *dir = NULL;
+        return true;
+    }
+
+    *dir = find_indexed_directory(&data->index, path);
+    if(*dir == NULL) return false;
+    range->first = *dir - data->index.files + 1;
+    range->last = (*dir)->subtree_end;
+    return true;
+}
+
+bool try_to_resolve_scope(indexing_data_t* data, char* path, file_range_t* range) {
+    if(path == NULL) {
+        *range = get_whole_index_range(&data->index);
+        return true;
+    }
+
+    char* resolved_path = resolve_indexed_path(path);
+    file_t* dir;
+    bool is_found = try_to_find_subtree(data, resolved_path, range, &dir);
+    if(!is_found) fprintf(stderr, "Directory %s is not indexed!\n", resolved_path);
+    free(resolved_path);
+    return is_found;
+}
+
+char* resolve_indexed_path(char* path) {
+    char* resolved = realpath(path, NULL);
+    if(resolved != NULL) return resolved;
+    resolved = strdup(path);
+    if(resolved == NULL) ERR("strdup");
+    size_t len = strlen(resolved);
+    while(len > 1 && resolved[len - 1] == '/') resolved[--len] = '\0';
+    return resolved;
+}
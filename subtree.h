@@ -0,0 +1,27 @@
+#ifndef SUBTREE_H
+#define SUBTREE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "index.h"
+
+// Records with indices in [first, last) of the index
+typedef struct file_range {
+    size_t first;
+    size_t last;
+} file_range_t;
+
+file_range_t get_whole_index_range(index_t* index);
+// Finds the contents of the indexed directory `path`, which directly follow it in the index.
+// `dir` is set to its record, or to NULL for the indexed root directory, which has no record.
+// Returns false if the directory is not indexed.
+bool try_to_find_subtree(indexing_data_t* data, char* path, file_range_t* range, file_t** dir);
+// Sets `range` to the contents of the directory `path`, or to the whole index if it is NULL.
+// Prints an error and returns false if the directory is not indexed.
+bool try_to_resolve_scope(indexing_data_t* data, char* path, file_range_t* range);
+// Returns an allocated absolute path, directories removed since indexing
+// can only be found by their indexed path
+char* resolve_indexed_path(char* path);
+
+#endif
@@ -0,0 +1,92 @@
+#include <unistd.h>
+
+#include "error.h"
+
+#include "thread_pool.h"
+
+void* pool_worker(void* void_pool);
+bool try_to_take_task(thread_pool_t* pool, size_t* task_id);
+
+void thread_pool_init(thread_pool_t* pool, size_t thread_count) {
+    if(thread_count == 0) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = processors > 0 ? processors : 1;
+    }
+
+    pool->thread_count = thread_count;
+    pool->task = NULL;
+    pool->task_arg = NULL;
+    pool->task_count = 0;
+    pool->next_task = 0;
+    pool->finished_tasks = 0;
+    pool->shutdown = false;
+    if(pthread_mutex_init(&pool->mx_pool, NULL)) ERR("pthread_mutex_init");
+    if(pthread_cond_init(&pool->cv_work_available, NULL)) ERR("pthread_cond_init");
+    if(pthread_cond_init(&pool->cv_work_done, NULL)) ERR("pthread_cond_init");
+
+    pool->threads = malloc(thread_count * sizeof(pthread_t));
+    if(pool->threads == NULL) ERR("malloc");
+    for(size_t i = 0; i < thread_count; ++i)
+        if(pthread_create(&pool->threads[i], NULL, pool_worker, pool)) ERR("pthread_create");
+}
+
+void thread_pool_run(thread_pool_t* pool, size_t task_count, pool_task_t task, void* arg) {
+    if(task_count == 0) return;
+
+    pthread_mutex_lock(&pool->mx_pool);
+    pool->task = task;
+    pool->task_arg = arg;
+    pool->task_count = task_count;
+    pool->next_task = 0;
+    pool->finished_tasks = 0;
+    pthread_cond_broadcast(&pool->cv_work_available);
+    while(pool->finished_tasks < pool->task_count)
+        pthread_cond_wait(&pool->cv_work_done, &pool->mx_pool);
+
+    pool->task_count = 0;
+    pool->next_task = 0;
+    pthread_mutex_unlock(&pool->mx_pool);
+}
+
+void* pool_worker(void* void_pool) {
+    thread_pool_t* pool = void_pool;
+    size_t task_id;
+    while(try_to_take_task(pool, &task_id)) {
+        pool->task(pool->task_arg, task_id);
+
+        pthread_mutex_lock(&pool->mx_pool);
+        pool->finished_tasks += 1;
+        if(pool->finished_tasks == pool->task_count)
+            pthread_cond_signal(&pool->cv_work_done);
+        pthread_mutex_unlock(&pool->mx_pool);
+    }
+
+    return NULL;
+}
+
+// Blocks until there is a task to do, returns false if the pool is being destroyed
+bool try_to_take_task(thread_pool_t* pool, size_t* task_id) {
+    pthread_mutex_lock(&pool->mx_pool);
+    while(!pool->shutdown && pool->next_task >= pool->task_count)
+        pthread_cond_wait(&pool->cv_work_available, &pool->mx_pool);
+
+    bool has_task = !pool->shutdown;
+    if(has_task) *task_id = pool->next_task++;
+    pthread_mutex_unlock(&pool->mx_pool);
+    return has_task;
+}
+
+void thread_pool_destroy(thread_pool_t* pool) {
+    pthread_mutex_lock(&pool->mx_pool);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->cv_work_available);
+    pthread_mutex_unlock(&pool->mx_pool);
+
+    for(size_t i = 0; i < pool->thread_count; ++i)
+        if(pthread_join(pool->threads[i], NULL)) ERR("pthread_join");
+
+    free(pool->threads);
+    pthread_cond_destroy(&pool->cv_work_done);
+    pthread_cond_destroy(&pool->cv_work_available);
+    pthread_mutex_destroy(&pool->mx_pool);
+}
@@ -0,0 +1,30 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+typedef void (*pool_task_t) (void* arg, size_t task_id);
+
+typedef struct thread_pool {
+    pthread_t* threads;
+    size_t thread_count;
+    pthread_mutex_t mx_pool;
+    pthread_cond_t cv_work_available;
+    pthread_cond_t cv_work_done;
+    pool_task_t task;
+    void* task_arg;
+    size_t task_count;
+    size_t next_task;
+    size_t finished_tasks;
+    bool shutdown;
+} thread_pool_t;
+
+// If `thread_count` is 0, one thread per online processor is started
+void thread_pool_init(thread_pool_t* pool, size_t thread_count);
+// Calls `task(arg, i)` for every i < `task_count` on the pool's threads and waits for all of them
+void thread_pool_run(thread_pool_t* pool, size_t task_count, pool_task_t task, void* arg);
+void thread_pool_destroy(thread_pool_t* pool);
+
+#endif
@@ -0,0 +1,136 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+
+#include "error.h"
+
+#include "throttle.h"
+
+// Not exported by glibc, values taken from linux/ioprio.h
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_WHO_PROCESS 1
+#define LOWEST_THREAD_PRIORITY 19
+
+// A single operation never sleeps longer than that, so that indexing can still be stopped quickly.
+// Budget which has not been paid off is carried over to the next operation.
+#define MAX_THROTTLE_SLEEP 1.0
+// Unused budget accumulates for at most that many seconds
+#define MAX_BURST_SECONDS 1.0
+
+void refill_tokens(throttle_t* throttle);
+double take_tokens(double* tokens, double amount, double rate);
+double get_seconds_between(struct timespec* from, struct timespec* to);
+void sleep_for(double seconds);
+
+void throttle_init(throttle_t* throttle, double ops_per_second, double bytes_per_second) {
+    if(pthread_mutex_init(&throttle->mx_throttle, NULL)) ERR("pthread_mutex_init");
+    throttle->throttled_seconds = 0.0;
+    throttle->throttled_ops = 0;
+    throttle_set_limits(throttle, ops_per_second, bytes_per_second);
+}
+
+void throttle_set_limits(throttle_t* throttle, double ops_per_second, double bytes_per_second) {
+    pthread_mutex_lock(&throttle->mx_throttle);
+    throttle->ops_per_second = ops_per_second;
+    throttle->bytes_per_second = bytes_per_second;
+    throttle->op_tokens = 0.0;
+    throttle->byte_tokens = 0.0;
+    if(clock_gettime(CLOCK_MONOTONIC, &throttle->last_refill)) ERR("clock_gettime");
+    pthread_mutex_unlock(&throttle->mx_throttle);
+}
+
+void throttle_get_limits(throttle_t* throttle, double* ops_per_second, double* bytes_per_second) {
+    pthread_mutex_lock(&throttle->mx_throttle);
+    *ops_per_second = throttle->ops_per_second;
+    *bytes_per_second = throttle->bytes_per_second;
+    pthread_mutex_unlock(&throttle->mx_throttle);
+}
+
+bool throttle_is_enabled(throttle_t* throttle) {
+    double ops_per_second, bytes_per_second;
+    throttle_get_limits(throttle, &ops_per_second, &bytes_per_second);
+    return ops_per_second != THROTTLE_UNLIMITED || bytes_per_second != THROTTLE_UNLIMITED;
+}
+
+void throttle_reset_stats(throttle_t* throttle) {
+    pthread_mutex_lock(&throttle->mx_throttle);
+    throttle->throttled_seconds = 0.0;
+    throttle->throttled_ops = 0;
+    pthread_mutex_unlock(&throttle->mx_throttle);
+}
+
+void throttle_get_stats(throttle_t* throttle, double* throttled_seconds, size_t* throttled_ops) {
+    pthread_mutex_lock(&throttle->mx_throttle);
+    *throttled_seconds = throttle->throttled_seconds;
+    *throttled_ops = throttle->throttled_ops;
+    pthread_mutex_unlock(&throttle->mx_throttle);
+}
+
+void throttle_operation(throttle_t* throttle, size_t bytes) {
+    if(throttle == NULL) return;
+
+    pthread_mutex_lock(&throttle->mx_throttle);
+    refill_tokens(throttle);
+    double ops_wait = take_tokens(&throttle->op_tokens, 1.0, throttle->ops_per_second);
+    double bytes_wait = take_tokens(&throttle->byte_tokens, bytes, throttle->bytes_per_second);
+    double wait = ops_wait > bytes_wait ? ops_wait : bytes_wait;
+    if(wait > MAX_THROTTLE_SLEEP) wait = MAX_THROTTLE_SLEEP;
+    if(wait > 0.0) {
+        throttle->throttled_seconds += wait;
+        throttle->throttled_ops += 1;
+    }
+    pthread_mutex_unlock(&throttle->mx_throttle);
+
+    if(wait > 0.0) sleep_for(wait);
+}
+
+void refill_tokens(throttle_t* throttle) {
+    struct timespec now;
+    if(clock_gettime(CLOCK_MONOTONIC, &now)) ERR("clock_gettime");
+    double elapsed = get_seconds_between(&throttle->last_refill, &now);
+    throttle->last_refill = now;
+
+    throttle->op_tokens += elapsed * throttle->ops_per_second;
+    if(throttle->op_tokens > throttle->ops_per_second * MAX_BURST_SECONDS)
+        throttle->op_tokens = throttle->ops_per_second * MAX_BURST_SECONDS;
+    throttle->byte_tokens += elapsed * throttle->bytes_per_second;
+    if(throttle->byte_tokens > throttle->bytes_per_second * MAX_BURST_SECONDS)
+        throttle->byte_tokens = throttle->bytes_per_second * MAX_BURST_SECONDS;
+}
+
+// Takes tokens from the bucket and returns how long the caller has to wait to pay off the debt
+double take_tokens(double* tokens, double amount, double rate) {
+    if(rate == THROTTLE_UNLIMITED) return 0.0;
+    *tokens -= amount;
+    return *tokens < 0.0 ? -*tokens / rate : 0.0;
+}
+
+double get_seconds_between(struct timespec* from, struct timespec* to) {
+    return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+void sleep_for(double seconds) {
+    struct timespec duration = {
+        .tv_sec = (time_t)seconds,
+        .tv_nsec = (long)((seconds - (time_t)seconds) * 1e9)
+    };
+    while(nanosleep(&duration, &duration) && errno == EINTR);
+}
+
+// Failures are not fatal, indexing is simply performed with the default priority
+void lower_thread_priority() {
+    int idle_priority = IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT;
+    if(syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, idle_priority))
+        perror("ioprio_set");
+    // On Linux, nice values are set per thread
+    if(setpriority(PRIO_PROCESS, syscall(SYS_gettid), LOWEST_THREAD_PRIORITY))
+        perror("setpriority");
+}
+
+void throttle_destroy(throttle_t* throttle) {
+    pthread_mutex_destroy(&throttle->mx_throttle);
+}
@@ -0,0 +1,37 @@
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+
+#define THROTTLE_UNLIMITED 0.0
+
+// Token buckets limiting the number of filesystem operations and bytes read per second
+// by the indexer. Limits can be changed at any moment from another thread.
+typedef struct throttle {
+    pthread_mutex_t mx_throttle;
+    double ops_per_second;
+    double bytes_per_second;
+    double op_tokens;
+    double byte_tokens;
+    struct timespec last_refill;
+    // Statistics of the current indexing process
+    double throttled_seconds;
+    size_t throttled_ops;
+} throttle_t;
+
+void throttle_init(throttle_t* throttle, double ops_per_second, double bytes_per_second);
+void throttle_set_limits(throttle_t* throttle, double ops_per_second, double bytes_per_second);
+void throttle_get_limits(throttle_t* throttle, double* ops_per_second, double* bytes_per_second);
+bool throttle_is_enabled(throttle_t* throttle);
+void throttle_reset_stats(throttle_t* throttle);
+void throttle_get_stats(throttle_t* throttle, double* throttled_seconds, size_t* throttled_ops);
+// Accounts for one operation which read `bytes` bytes, sleeps if the budget is exhausted
+void throttle_operation(throttle_t* throttle, size_t bytes);
+// Puts the calling thread into the idle I/O scheduling class and lowers its CPU priority
+void lower_thread_priority();
+void throttle_destroy(throttle_t* throttle);
+
+#endif
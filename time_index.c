@@ -0,0 +1,103 @@
+#include <string.h>
+
+#include "error.h"
+#include "index.h"
+
+#include "time_index.h"
+
+time_order_t* get_time_order(time_index_t* time_index, index_t* index, time_field_t field);
+void sort_by_time(time_order_t* order, index_t* index, time_field_t field);
+time_t get_file_time(file_t* file, time_field_t field);
+int compare_timed_files(const void* a, const void* b);
+size_t find_first_later(time_order_t* order, time_t time);
+int compare_file_ids(const void* a, const void* b);
+
+void time_index_init(time_index_t* time_index) {
+    for(size_t i = 0; i < TIME_FIELD_COUNT; ++i)
+        time_index->orders[i] = (time_order_t){ .files = NULL, .files_count = 0 };
+}
+
+size_t time_index_select(
+    time_index_t* time_index,
+    index_t* index,
+    time_field_t field,
+    time_t time,
+    bool is_newer,
+    size_t* file_ids
+) {
+    time_order_t* order = get_time_order(time_index, index, field);
+    size_t first, last;
+    if(is_newer) {
+        first = find_first_later(order, time);
+        last = order->files_count;
+    }
+    else {
+        first = 0;
+        last = find_first_later(order, time - 1);
+    }
+
+    size_t items = last - first;
+    for(size_t i = 0; i < items; ++i) file_ids[i] = order->files[first + i].file_id;
+    // Results of all queries are in the index order
+    qsort(file_ids, items, sizeof(size_t), compare_file_ids);
+    return items;
+}
+
+time_order_t* get_time_order(time_index_t* time_index, index_t* index, time_field_t field) {
+    time_order_t* order = &time_index->orders[field];
+    if(order->files == NULL || order->generation != index->generation) {
+        free(order->files);
+        sort_by_time(order, index, field);
+    }
+
+    return order;
+}
+
+void sort_by_time(time_order_t* order, index_t* index, time_field_t field) {
+    order->files = malloc(index->files_count * sizeof(timed_file_t));
+    if(index->files_count != 0 && order->files == NULL) ERR("malloc");
+    for(size_t i = 0; i < index->files_count; ++i) {
+        order->files[i].time = get_file_time(&index->files[i], field);
+        order->files[i].file_id = i;
+    }
+
+    qsort(order->files, index->files_count, sizeof(timed_file_t), compare_timed_files);
+    order->files_count = index->files_count;
+    order->generation = index->generation;
+}
+
+time_t get_file_time(file_t* file, time_field_t field) {
+    return field == CHANGE_TIME ? file->ctime : file->mtime;
+}
+
+int compare_timed_files(const void* a, const void* b) {
+    const timed_file_t* fa = a;
+    const timed_file_t* fb = b;
+    if(fa->time != fb->time) return fa->time < fb->time ? -1 : 1;
+    return (fa->file_id > fb->file_id) - (fa->file_id < fb->file_id);
+}
+
+// Binary search for the first file with time greater than `time`
+size_t find_first_later(time_order_t* order, time_t time) {
+    size_t low = 0, high = order->files_count;
+    while(low < high) {
+        size_t middle = low + (high - low) / 2;
+        if(order->files[middle].time <= time) low = middle + 1;
+        else high = middle;
+    }
+
+    return low;
+}
+
+int compare_file_ids(const void* a, const void* b) {
+    size_t ia = *(const size_t*)a;
+    size_t ib = *(const size_t*)b;
+    return (ia > ib) - (ia < ib);
+}
+
+void time_index_destroy(time_index_t* time_index) {
+    for(size_t i = 0; i < TIME_FIELD_COUNT; ++i) {
+        free(time_index->orders[i].files);
+        time_index->orders[i].files = NULL;
+    }
+}
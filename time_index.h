@@ -0,0 +1,47 @@
+#ifndef TIME_INDEX_H
+#define TIME_INDEX_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+struct index;
+
+typedef enum time_field {
+    MODIFICATION_TIME,
+    CHANGE_TIME,
+    TIME_FIELD_COUNT
+} time_field_t;
+
+typedef struct timed_file {
+    time_t time;
+    size_t file_id;
+} timed_file_t;
+
+// Files of a single index generation ordered by one of their times, NULL if not sorted yet
+typedef struct time_order {
+    timed_file_t* files;
+    size_t files_count;
+    uint64_t generation;
+} time_order_t;
+
+// Every time field is sorted when it is queried for the first time in a generation
+typedef struct time_index {
+    time_order_t orders[TIME_FIELD_COUNT];
+} time_index_t;
+
+void time_index_init(time_index_t* time_index);
+// Stores indices of files whose `field` is later than `time` (earlier if `is_newer` is false)
+// in `file_ids` in the index order and returns their number
+size_t time_index_select(
+    time_index_t* time_index,
+    struct index* index,
+    time_field_t field,
+    time_t time,
+    bool is_newer,
+    size_t* file_ids
+);
+void time_index_destroy(time_index_t* time_index);
+
+#endif